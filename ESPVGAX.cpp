@@ -1,23 +1,108 @@
 #include "ESPVGAX.h"
 
+#ifdef ESPVGAX_NO_FRAMEBUFFER
+// no framebuffer, see espvgax_text.h and espvgax_tiles.h
+#elif defined(ESPVGAX_DOUBLE_BUFFER)
+static volatile uint32_t ESPVGAX_ALIGN32 fb0[ESPVGAX_HEIGHT][ESPVGAX_WWIDTH];
+static volatile uint32_t ESPVGAX_ALIGN32 fb1[ESPVGAX_HEIGHT][ESPVGAX_WWIDTH];
+// back buffer
+volatile uint32_t (*ESPVGAX::fbw)[ESPVGAX_WWIDTH]=fb1;
+// front buffer, read by vga_handler
+static volatile uint32_t (*volatile front)[ESPVGAX_WWIDTH]=fb0;
+// next front buffer, set by flip and consumed by vga_handler at vActive
+static volatile uint32_t (*volatile flipping)[ESPVGAX_WWIDTH];
+#ifdef ESPVGAX_DIRTY_MAP
+uint32_t ESPVGAX::dirty[ESPVGAX_HEIGHT];
+#endif
+#else
 volatile uint32_t ESPVGAX_ALIGN32 ESPVGAX::fbw[ESPVGAX_HEIGHT][ESPVGAX_WWIDTH];
+#define front ESPVGAX::fbw
+#endif
 
 static volatile uint32_t ESPVGAX_ALIGN32 empty[ESPVGAX_WWIDTH];
 static volatile uint32_t *line;
+#ifdef ESPVGAX_HSCROLL
+// horizontal offset of each VGA line, see ESPVGAX::setLineScroll
+static volatile uint16_t hscroll[480];
+// horizontal offset of the next line
+static uint32_t linescroll;
+#define LINE_SCROLL linescroll
+#else
+#define LINE_SCROLL 0
+#endif
 static volatile int fby;
 static volatile int vsync;
 static volatile int running;
+static volatile int installed;
+static volatile uint32_t frames;
+
+const ESPVGAX::ModeTiming ESPVGAX::TIMING_640x480_60={
+  25175000, 800, 640, 96, 48, 525, 480, 490, 492, 0 };
+const ESPVGAX::ModeTiming ESPVGAX::TIMING_640x400_70={
+  25175000, 800, 640, 96, 48, 449, 400, 412, 414, ESPVGAX_VSYNC_POSITIVE };
+const ESPVGAX::ModeTiming ESPVGAX::TIMING_640x350_70={
+  25175000, 800, 640, 96, 48, 449, 350, 387, 389, ESPVGAX_HSYNC_POSITIVE };
+const ESPVGAX::ModeTiming ESPVGAX::TIMING_640x480_55={
+  25175000, 864, 640, 96, 48, 525, 480, 490, 492, 0 };
+static const ESPVGAX::ModeTiming *timing=&ESPVGAX::TIMING_640x480_60;
+
+/*
+ * timing converted by begin for vga_handler. The line period is in CPU cycles
+ * with 16 bits of fractional part: linefrac accumulates the fractions, so 
+ * the CCOUNT of the next line (linedeadline) never drifts
+ */
+static uint32_t lineperiod;
+static uint32_t linedeadline;
+static uint32_t linefrac;
+// CPU cycles from the beginning of HSYNC to its end and to the pixeldata
+static uint32_t hsynccycles;
+static uint32_t datacycles;
+static int vtotal, vactive, vsyncstart, vsyncend;
+// GPIO set/clear registers used to begin and end the sync pulses
+static int hsyncon, hsyncoff, vsyncon, vsyncoff;
+// VGA lines displayed from the framebuffer window, from ESPVGAX_WINDOW_TOP
+#define WINDOW_LINES (ESPVGAX_HEIGHT<<ESPVGAX_YSHIFT)
+static uint32_t windowlines;
+// framebuffer row displayed at the VGA line y, without display list
+#define DEFAULT_ROW(y) (((y)-ESPVGAX_WINDOW_TOP)>>ESPVGAX_YSHIFT)
+
+#ifdef ESPVGAX_DISPLAY_LIST
+/*
+ * framebuffer row displayed at each VGA line, see ESPVGAX::setDisplayRow.
+ * Stored as difference from the default row, so that a zero filled table
+ * displays the framebuffer rows in order
+ */
+static volatile int16_t displaylist[480];
+#define DISPLAY_ROW(y) (DEFAULT_ROW(y)+displaylist[y])
+#else
+#define DISPLAY_ROW(y) DEFAULT_ROW(y)
+#endif
+
+// raster line callbacks, see ESPVGAX::setLineCallback
+static ESPVGAX::LineCallback callbacks[ESPVGAX_LINE_CALLBACKS];
+static int callbacksy[ESPVGAX_LINE_CALLBACKS];
+static int callbackscount;
+static int callbacknext;
 
 #ifdef ESPVGAX_EXTRA_COLORS
 volatile uint8_t props[525];
 #endif
 
+#ifndef ESPVGAX_NO_FRAMEBUFFER
 volatile uint8_t *ESPVGAX::fbb=(volatile uint8_t*)&ESPVGAX::fbw[0];
+#endif
 
-#include "espvgax_hspi.h"
-
-// wait a fixed numbers of CPU cycles
-#define NOP_DELAY(N) asm volatile(".rept " #N "\n\t nop \n\t .endr \n\t":::)
+#ifndef ESPVGAX_HOST
+// CPU cycles accounting, used only by the host backend (see espvgax_host.h)
+#define ESPVGAX_HOST_STORE(n)
+#define ESPVGAX_HOST_SCROLL(n)
+#define ESPVGAX_HOST_TEXT(n)
+#define ESPVGAX_HOST_TILES(n)
+#define ESPVGAX_HOST_SPRITES(n)
+#define ESPVGAX_HOST_OVERLAY(words, n)
+#define ESPVGAX_HOST_STAGED()
+#define ESPVGAX_HOST_SPIN()
+#endif
 
 #define US_TO_RTC_TIMER_TICKS(t) \
   ((t) ? \
@@ -28,21 +113,85 @@ volatile uint8_t *ESPVGAX::fbb=(volatile uint8_t*)&ESPVGAX::fbw[0];
    0)
 
 static inline uint32_t getTicks() {
+#ifdef ESPVGAX_HOST
+  return ESPVGAXHost::ticks();
+#else
   uint32_t ccount;
   asm volatile ("rsr %0, ccount":"=a"(ccount));
   return ccount;
+#endif
 }
 #define TICKS (getTicks())
 
+#include "espvgax_hspi.h"
+
+// CPU cycles of n pixels of the timing t
+static uint32_t pixelsToCycles(const ESPVGAX::ModeTiming &t, uint32_t n) {
+  return (uint64_t)n*F_CPU/t.pixelClock;
+}
+// CPU cycles between two vga_handler calls, with 16 bits of fractional part
+static uint32_t linePeriod(const ESPVGAX::ModeTiming &t) {
+  return ((uint64_t)t.hTotal*F_CPU<<16)/t.pixelClock;
+}
+// CPU cycles between two vga_handler calls
+#define LINE_CYCLES (lineperiod>>16)
+/*
+ * min timer1 ticks (APB clock cycles) to the next interrupt, used when the 
+ * deadline is already passed
+ */
+#define TIMER1_MIN_TICKS 16
+
+// CPU cycles used by vga_handler, since begin and in the last complete frame
+static volatile uint32_t isrcycles;
+static volatile uint32_t frameisrcycles;
+static uint32_t frameisrstart;
+/*
+ * CPU cycles saved by the vertical blank lines that skip the HSPI, in the 
+ * current and in the last complete frame, compared with the last line that
+ * has sent pixeldata (sendcycles)
+ */
+static uint32_t savedcycles;
+static volatile uint32_t framesavedcycles;
+static uint32_t sendcycles;
+
+//include vga_handler statistics (ESPVGAX_STATS)
+#include "espvgax_stats.h"
+
+#ifdef ESPVGAX_TEXT_MODE
+//include the text mode, composes the lines from the characters
+#include "espvgax_text.h"
+// line of the framebuffer window displayed from its row
+#define WINDOW_ROW(row) text_line(row)
+#elif defined(ESPVGAX_TILE_MODE)
+//include the tile mode, composes the lines from the tiles and the sprites
+#include "espvgax_tiles.h"
+#define WINDOW_ROW(row) tile_line(row)
+#else
+#define WINDOW_ROW(row) front[row]
+#endif
+
+//include the overlay sprites (ESPVGAX_OVERLAYS)
+#include "espvgax_overlay.h"
+
 void ICACHE_RAM_ATTR vga_handler() {
+  uint32_t t0=TICKS;
   noInterrupts();
+  // begin HSYNC
+  ESP8266_REG(hsyncon)=1<<ESPVGAX_HSYNC_PIN;
+  uint32_t th=TICKS;
+  // schedule the next line from the expected CCOUNT of this one
+  uint32_t deadline=linedeadline;
+  linefrac+=lineperiod & 0xffff;
+  linedeadline+=(lineperiod>>16)+(linefrac>>16);
+  linefrac&=0xffff;
 #if ESPVGAX_TIMER==0
-  // timer0 need to be scheduled again
-  timer0_write(TICKS+16*US_TO_RTC_TIMER_TICKS(32));
+  timer0_write(linedeadline);
+#else
+  int32_t ticks=(int32_t)(linedeadline-TICKS)/(F_CPU/APB_CLK_FREQ);
+  timer1_write(ticks>TIMER1_MIN_TICKS ? ticks : TIMER1_MIN_TICKS);
 #endif
-  // begin negative HSYNC
-  GPOC=1<<ESPVGAX_HSYNC_PIN;
 #ifdef ESPVGAX_EXTRA_COLORS
+  // properties of the VGA line, also outside of the framebuffer window
   uint8_t pr=props[fby];
   if (pr & ESPVGAX_PROP_COLOR1) 
     GP16O |= 1;
@@ -52,45 +201,84 @@ void ICACHE_RAM_ATTR vga_handler() {
     GPOS=1<<ESPVGAX_EXTRA_COLOR2_PIN;
   else
     GPOC=1<<ESPVGAX_EXTRA_COLOR2_PIN; 
-#if F_CPU==80000000L
-  NOP_DELAY(100); // 2us*80MHz (- 60clock becouse extra colors require time)
-#else
-  NOP_DELAY(400); // should be 320 (2us*160MHz) but 400 works well
-#endif  
-#else // ESPVGAX_EXTRA_COLORS not defined
-#if F_CPU==80000000L
-  NOP_DELAY(160); // 2us*80MHz
+#endif
+  /*
+   * copy the line to HSPI during HSYNC, the previous line has been sent. The
+   * vertical blank sends a black line, so the MOSI pin stays low, then skips
+   * the HSPI until its last line, that restores the W registers outside of
+   * the framebuffer window
+   */
+  bool send=running && fby<=vactive;
+  if (running) {
+    if (fby<vactive) {
+#ifdef ESPVGAX_HSCROLL
+      HSPI_VGA_scroll(linescroll);
+#elif defined(ESPVGAX_SPI_PIPELINE)
+      HSPI_VGA_stage();
 #else
-  NOP_DELAY(480); // should be 320 (2us*160MHz) but 480 works well
-#endif  
+      HSPI_VGA_prepare();
 #endif
-  // end negative HSYNC
-  GPOS=1<<ESPVGAX_HSYNC_PIN;
+    } else if (fby==vactive) {
+      HSPI_VGA_fill(0);
+    } else if (fby==vtotal-1) {
+      HSPI_VGA_fill(ESPVGAX_WINDOW_FILL);
+    }
+  }
+  STATS_WAIT(while (TICKS-th<hsynccycles));
+  // end HSYNC
+  ESP8266_REG(hsyncoff)=1<<ESPVGAX_HSYNC_PIN;
   // begin or end VSYNC, depending of value of vsync variable
   ESP8266_REG(vsync)=1<<ESPVGAX_VSYNC_PIN;
-  //write PIXELDATA
-  if (running) {
-    HSPI_VGA_prepare();
-    HSPI_VGA_send();
+  //write PIXELDATA after the back porch
+  if (send) {
+    HSPI_VGA_first();
+    STATS_WAIT(while (TICKS-th<datacycles));
+    if (fby<vactive)
+      HSPI_VGA_send();
+    else
+      HSPI_VGA_start();
   }
   // prepare for the next vga_handler run
   fby++;
-  switch (fby) {
-  case 525: 
+  if (fby==vactive) {
+    // beginning of vertical blank
+    frames++;
+#ifdef ESPVGAX_DOUBLE_BUFFER
+    // the front buffer can be swapped
+    if (flipping) {
+      front=flipping;
+      flipping=0;
+    }
+#endif
+  } else if (fby==vtotal) {
     // restart from the beginning
     fby=0; 
-    break;
-  case 490: 
-    // next line will begin negative VSYNC 
-    vsync=0x308; 
-    break;
-  case 492: 
-    // next line will end negative VSYNC
-    vsync=0x304; 
-    break;
+    callbacknext=0;
   }
-  // fetch the next line, or empty line in case of VGA lines [480..524]
-  line=(fby<ESPVGAX_HEIGHT) ? ESPVGAX::fbw[fby] : empty;
+  // next line will begin or end VSYNC
+  if (fby==vsyncstart)
+    vsync=vsyncon;
+  else if (fby==vsyncend)
+    vsync=vsyncoff;
+  // raster line callbacks, sorted by line
+  if (callbacknext<callbackscount && callbacksy[callbacknext]==fby) {
+    callbacks[callbacknext](fby);
+    callbacknext++;
+  }
+  /*
+   * fetch the next line, or empty line in case of VGA lines outside of the 
+   * framebuffer window and of the vertical blank
+   */
+  line=((uint32_t)(fby-ESPVGAX_WINDOW_TOP)<windowlines) ? 
+    WINDOW_ROW(DISPLAY_ROW(fby)) : empty;
+#ifdef ESPVGAX_HSCROLL
+  linescroll=(fby<480) ? hscroll[fby] : 0;
+#endif
+#ifdef ESPVGAX_OVERLAYS
+  // merge the overlays in a copy of the line, at their screen position
+  if ((uint32_t)(fby-ESPVGAX_WINDOW_TOP)<windowlines)
+    line=overlay_line(line, DEFAULT_ROW(fby), LINE_SCROLL);
+#endif
   interrupts();
   /* 
    * feed the dog. keep ESP8266 WATCHDOG awake. VGA signal generation works 
@@ -102,8 +290,23 @@ void ICACHE_RAM_ATTR vga_handler() {
    * see the VGAX dejitter nightmare
    */
   ESP.wdtFeed(); 
+  // CPU cycles accounting, see ESPVGAX::frameISRCycles
+  uint32_t t1=TICKS;
+  uint32_t d=t1-t0;
+  isrcycles+=d;
+  if (send)
+    sendcycles=d;
+  else if (running && sendcycles>d)
+    savedcycles+=sendcycles-d;
+  if (fby==0) {
+    frameisrcycles=isrcycles-frameisrstart;
+    frameisrstart=isrcycles;
+    framesavedcycles=savedcycles;
+    savedcycles=0;
+  }
+  STATS_UPDATE(t0, t1, deadline);
 }
-void ESPVGAX::begin() {
+void ESPVGAX::begin(const ModeTiming &t) {
   pinMode(ESPVGAX_VSYNC_PIN, OUTPUT);
   pinMode(ESPVGAX_HSYNC_PIN, OUTPUT);
   pinMode(ESPVGAX_COLOR_PIN, OUTPUT);
@@ -111,28 +314,75 @@ void ESPVGAX::begin() {
   pinMode(ESPVGAX_EXTRA_COLOR1_PIN, OUTPUT);
   pinMode(ESPVGAX_EXTRA_COLOR2_PIN, OUTPUT);
 #endif
+  // convert the timing for vga_handler
+  timing=&t;
+  lineperiod=linePeriod(t);
+  hsynccycles=pixelsToCycles(t, t.hSync);
+  /*
+   * center the pixeldata (ESPVGAX_LINE_WIDTH pixels and the seams of the wide
+   * modes) in the active pixels. A line longer than them, like the 25.6us of
+   * 512 pixels at 20MHz, begins in the back porch and ends in the front one
+   */
+  int32_t pixels=HSPI_LINE_CYCLES;
+  datacycles=pixelsToCycles(t, t.hSync+t.hBackPorch)+
+    ((int32_t)pixelsToCycles(t, t.hActive)-pixels)/2-HSPI_START_CYCLES;
+  vtotal=t.vTotal;
+  vactive=t.vActive;
+  // drop the raster line callbacks after the last line of the new timing
+  while (callbackscount && callbacksy[callbackscount-1]>=vtotal)
+    callbackscount--;
+  vsyncstart=t.vSyncStart;
+  vsyncend=t.vSyncEnd;
+  hsyncon=(t.polarity & ESPVGAX_HSYNC_POSITIVE) ? 0x304 : 0x308;
+  hsyncoff=hsyncon ^ (0x304 ^ 0x308);
+  vsyncon=(t.polarity & ESPVGAX_VSYNC_POSITIVE) ? 0x304 : 0x308;
+  vsyncoff=vsyncon ^ (0x304 ^ 0x308);
+  windowlines=vactive>ESPVGAX_WINDOW_TOP ? vactive-ESPVGAX_WINDOW_TOP : 0;
+  if (windowlines>WINDOW_LINES)
+    windowlines=WINDOW_LINES;
   // prepare first line
+  for (int i=0; i!=ESPVGAX_WWIDTH; i++)
+    empty[i]=ESPVGAX_WINDOW_FILL;
   fby=0;
-  line=fbw[0];
-  // begin with positive VSYNC
-  vsync=0x304;
+  line=windowlines && !ESPVGAX_WINDOW_TOP ? WINDOW_ROW(DISPLAY_ROW(0)) : empty;
+  // begin with inactive sync pulses
+  ESP8266_REG(hsyncoff)=1<<ESPVGAX_HSYNC_PIN;
+  vsync=vsyncoff;
   running=1;
   // setup HSPI to output PIXELDATA on D7 PIN 
   HSPI_VGA_init();
+#ifdef ESPVGAX_SPI_PIPELINE
+  /*
+   * the transfer done interrupt runs between the end of the pixeldata and 
+   * the next line: enable it only if it has the time to end
+   */
+  HSPI_VGA_pipeline((int32_t)(LINE_CYCLES-datacycles)-HSPI_LINE_CYCLES>
+    HSPI_PIPELINE_CYCLES);
+#endif
   // install vga_handler interrupt
   noInterrupts();
+  linefrac=0;
+  linedeadline=TICKS+LINE_CYCLES;
 #if ESPVGAX_TIMER==0
   timer0_isr_init();
   timer0_attachInterrupt(vga_handler);
-  timer0_write(TICKS+16*US_TO_RTC_TIMER_TICKS(32));
+  timer0_write(linedeadline);
 #else
+  /*
+   * single shot timer1, programmed again by vga_handler for each line with 
+   * the APB cycles left to the next deadline 
+   */
   timer1_isr_init();
   timer1_attachInterrupt(vga_handler);
-  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
-  timer1_write(US_TO_RTC_TIMER_TICKS(32));
+  timer1_enable(TIM_DIV1, TIM_EDGE, TIM_SINGLE);
+  timer1_write(LINE_CYCLES/(F_CPU/APB_CLK_FREQ));
 #endif
+  installed=1;
   interrupts();
 }
+const ESPVGAX::ModeTiming &ESPVGAX::getModeTiming() {
+  return *timing;
+}
 void ESPVGAX::pause() {
   running=0;
 }
@@ -147,7 +397,217 @@ void ESPVGAX::end() {
 #else
   timer1_detachInterrupt();
 #endif
+  installed=0;
+#ifdef ESPVGAX_SPI_PIPELINE
+  HSPI_VGA_pipeline(false);
+#endif
+  interrupts();
+}
+bool ESPVGAX::setLineCallback(int y, LineCallback cb) {
+  if (y<0 || y>=timing->vTotal)
+    return false;
+  noInterrupts();
+  // remove the current callback of line y, if any
+  int i=0;
+  while (i<callbackscount && callbacksy[i]<y)
+    i++;
+  if (i<callbackscount && callbacksy[i]==y) {
+    memmove(&callbacks[i], &callbacks[i+1], 
+      (callbackscount-i-1)*sizeof(callbacks[0]));
+    memmove(&callbacksy[i], &callbacksy[i+1], 
+      (callbackscount-i-1)*sizeof(callbacksy[0]));
+    callbackscount--;
+  }
+  bool ret=true;
+  if (cb && callbackscount==ESPVGAX_LINE_CALLBACKS) {
+    ret=false;
+  } else if (cb) {
+    // insert the new one, keeping the list sorted
+    memmove(&callbacks[i+1], &callbacks[i], 
+      (callbackscount-i)*sizeof(callbacks[0]));
+    memmove(&callbacksy[i+1], &callbacksy[i], 
+      (callbackscount-i)*sizeof(callbacksy[0]));
+    callbacks[i]=cb;
+    callbacksy[i]=y;
+    callbackscount++;
+  }
+  // skip the callbacks of the lines already sent in this frame
+  callbacknext=0;
+  while (callbacknext<callbackscount && callbacksy[callbacknext]<=fby)
+    callbacknext++;
   interrupts();
+  return ret;
+}
+#ifdef ESPVGAX_DISPLAY_LIST
+// reverse the display list entries [y0..y1)
+static void reverseDisplayList(int y0, int y1) {
+  while (y0<--y1) {
+    int row=DISPLAY_ROW(y0);
+    displaylist[y0]=DISPLAY_ROW(y1)-DEFAULT_ROW(y0);
+    displaylist[y1]=row-DEFAULT_ROW(y1);
+    y0++;
+  }
+}
+#endif
+void ESPVGAX::setDisplayRow(int y, int row) {
+#ifdef ESPVGAX_DISPLAY_LIST
+  if (y<0 || y>=480 || isYOutside(row))
+    return;
+  displaylist[y]=row-DEFAULT_ROW(y);
+#else
+  (void)y; (void)row;
+#endif
+}
+int ESPVGAX::getDisplayRow(int y) {
+  if (y<0 || y>=480)
+    return -1;
+  return DISPLAY_ROW(y);
+}
+void ESPVGAX::resetDisplayList() {
+#ifdef ESPVGAX_DISPLAY_LIST
+  memset((void*)displaylist, 0, sizeof(displaylist));
+#endif
+}
+void ESPVGAX::rotateDisplayList(int y0, int y1, int n) {
+#ifdef ESPVGAX_DISPLAY_LIST
+  if (y0<0)
+    y0=0;
+  if (y1>480)
+    y1=480;
+  int len=y1-y0;
+  if (len<=1)
+    return;
+  n%=len;
+  if (n<0)
+    n+=len;
+  if (!n)
+    return;
+  // rotate left by n with three reversals, in place
+  reverseDisplayList(y0, y0+n);
+  reverseDisplayList(y0+n, y1);
+  reverseDisplayList(y0, y1);
+#else
+  (void)y0; (void)y1; (void)n;
+#endif
+}
+void ESPVGAX::setLineScroll(int y, int offset) {
+#ifdef ESPVGAX_HSCROLL
+  if (y<0 || y>=480)
+    return;
+  offset%=ESPVGAX_WIDTH;
+  if (offset<0)
+    offset+=ESPVGAX_WIDTH;
+  hscroll[y]=offset;
+#else
+  (void)y; (void)offset;
+#endif
+}
+void ESPVGAX::setLinesScroll(int y, int end, int offset) {
+  while (y<end)
+    setLineScroll(y++, offset);
+}
+int ESPVGAX::getLineScroll(int y) {
+#ifdef ESPVGAX_HSCROLL
+  if (y<0 || y>=480)
+    return 0;
+  return hscroll[y];
+#else
+  (void)y;
+  return 0;
+#endif
+}
+uint32_t ESPVGAX::frameCount() {
+  return frames;
+}
+int ESPVGAX::currentLine() {
+  // fby is the next line, the HSPI is sending the previous one
+  int y=fby;
+  return y ? y-1 : timing->vTotal-1;
+}
+void ESPVGAX::waitVSync() {
+  uint32_t f=frames;
+  while (installed && f==frames)
+    ESPVGAX_HOST_SPIN();
+}
+void ESPVGAX::waitLine(int y) {
+  if (y<0 || y>=timing->vTotal)
+    return;
+  while (installed && currentLine()!=y)
+    ESPVGAX_HOST_SPIN();
+}
+void ESPVGAX::flip() {
+#ifdef ESPVGAX_DOUBLE_BUFFER
+  volatile uint32_t (*back)[ESPVGAX_WWIDTH]=front;
+  if (installed) {
+    // wait for vga_handler to swap the buffers at line vActive
+    flipping=fbw;
+    while (flipping)
+      ESPVGAX_HOST_SPIN();
+  } else {
+    front=fbw;
+  }
+  fbw=back;
+  fbb=(volatile uint8_t*)&fbw[0];
+#ifdef ESPVGAX_DIRTY_MAP
+  memset(dirty, 0, sizeof(dirty));
+#endif
+#endif
+}
+void ESPVGAX::commit() {
+#ifdef ESPVGAX_DIRTY_MAP
+  // copy from the beginning of the vertical blank
+  waitVSync();
+  for (int y=0; y!=ESPVGAX_HEIGHT; y++) {
+    uint32_t m=dirty[y];
+    if (!m)
+      continue;
+    dirty[y]=0;
+    volatile uint32_t *src=fbw[y];
+    volatile uint32_t *dst=front[y];
+    do {
+      int i=__builtin_ctz(m);
+      dst[i]=src[i];
+      m&=m-1;
+    } while (m);
+  }
+#endif
+}
+void ESPVGAX::markDirty(int x, int y, int w, int h) {
+#ifdef ESPVGAX_DIRTY_MAP
+  int x1=x+w, y1=y+h;
+  if (x<0)
+    x=0;
+  if (y<0)
+    y=0;
+  if (x1>ESPVGAX_WIDTH)
+    x1=ESPVGAX_WIDTH;
+  if (y1>ESPVGAX_HEIGHT)
+    y1=ESPVGAX_HEIGHT;
+  if (x>=x1 || y>=y1)
+    return;
+  // words from x to x1-1
+  uint32_t m=(0xffffffff<<(x*ESPVGAX_BPP>>5)) & 
+    (0xffffffff>>(31-((x1*ESPVGAX_BPP-1)>>5)));
+  for (; y!=y1; y++)
+    dirty[y]|=m;
+#else
+  (void)x; (void)y; (void)w; (void)h;
+#endif
+}
+uint32_t ESPVGAX::ticks() {
+  return TICKS;
+}
+uint32_t ESPVGAX::frameCycles() {
+  return ((uint64_t)linePeriod(*timing)*timing->vTotal)>>16;
+}
+uint32_t ESPVGAX::frameISRCycles() {
+  return frameisrcycles;
+}
+uint32_t ESPVGAX::frameSavedCycles() {
+  return framesavedcycles;
+}
+uint32_t ESPVGAX::isrCycles() {
+  return isrcycles;
 }
 void ICACHE_RAM_ATTR ESPVGAX::delay(uint32_t msec) {
   // predict the CPU ticks to be awaited
@@ -186,21 +646,26 @@ void ESPVGAX::setLinesProp(int y, int end, uint8_t prop) {
   while (y<end) 
     setLineProp(y++, prop);
 }
-void ESPVGAX::setLineProp(int y, uint8_t prop) {
+void ICACHE_RAM_ATTR ESPVGAX::setLineProp(int y, uint8_t prop) {
 #ifdef ESPVGAX_EXTRA_COLORS
-  if (y>=ESPVGAX_HEIGHT) 
+  if (y<0 || y>=480) 
     return;
   props[y]=prop;
 #else
+  (void)y; (void)prop;
 #endif
 }
-uint8_t ESPVGAX::getLineProp(int y) {
+uint8_t ICACHE_RAM_ATTR ESPVGAX::getLineProp(int y) {
 #ifdef ESPVGAX_EXTRA_COLORS
+  if (y<0 || y>=480)
+    return 0;
   return props[y];
 #else
+  (void)y;
   return 0;
 #endif
 }
+#ifndef ESPVGAX_NO_FRAMEBUFFER
 //include blit methods, implemented via a bunch of macros
 #include "espvgax_blit.h"
 
@@ -209,3 +674,4 @@ uint8_t ESPVGAX::getLineProp(int y) {
 
 //include draw primitives methods
 #include "espvgax_draw.h"
+#endif
@@ -19,15 +19,195 @@ hardware wiring and library usage.
 
 #define ESPVGAX_VERSION "1.0.0"
 
+#ifdef ESPVGAX_HOST
+// build for a PC, with ESP8266 hardware emulation. See espvgax_host.h
+#include "espvgax_host.h"
+#else
 #include <ESP8266WiFi.h>
 #include <Arduino.h>
+#endif
+
+/*
+ * framebuffer resolution. The VGA signal timing is selected in begin (see 
+ * ESPVGAX::ModeTiming), lower resolutions require less RAM:
+ *    ESPVGAX_MODE_512x480: 30KB framebuffer
+ *    ESPVGAX_MODE_512x240: each framebuffer line is displayed two times, 15KB
+ *    ESPVGAX_MODE_256x240: each framebuffer line is displayed two times and
+ *      each pixel is two times wider (HSPI clock is halved), 7.5KB
+ * Wide modes send more than the 512 bits of the HSPI W registers for each 
+ * line, in chunks of 256 pixels. The interrupt handler refills the HSPI 
+ * while the line is sent, so it uses about 95% of each visible line:
+ *    ESPVGAX_MODE_640x480: 37.5KB framebuffer, 26.7MHz pixel clock
+ *    ESPVGAX_MODE_640x240: 18.75KB, each framebuffer line is displayed two
+ *      times
+ *    ESPVGAX_MODE_800x480: 46.9KB framebuffer, 40MHz pixel clock
+ *    ESPVGAX_MODE_800x240: 23.4KB, each framebuffer line is displayed two 
+ *      times
+ * All drawing primitives works in the same way with all resolutions. Use
+ * ESPVGAX_WIDTH and ESPVGAX_HEIGHT instead of fixed values (see also the
+ * framebuffer window below)
+ */
+#define ESPVGAX_MODE_512x480 0
+#define ESPVGAX_MODE_512x240 1
+#define ESPVGAX_MODE_256x240 2
+#define ESPVGAX_MODE_640x480 3
+#define ESPVGAX_MODE_640x240 4
+#define ESPVGAX_MODE_800x480 5
+#define ESPVGAX_MODE_800x240 6
+#ifndef ESPVGAX_MODE
+#define ESPVGAX_MODE ESPVGAX_MODE_512x480
+#endif
+/*
+ * bits per pixel. With 1 (the default) the pixeldata is sent on D7 only. 
+ * With 2 the HSPI sends the pixeldata on 2 pins (dual output, 
+ * SPI_FWRITE_DUAL): each SPI clock puts a pixel of 4 colors or grey levels
+ * on D7 (bit 0) and D6 (bit 1). For example D7 wired to green and D6 to red
+ * give black, green, red and amber. The framebuffer is 2 times bigger: 
+ * ESPVGAX_MODE_512x240 requires 30KB, ESPVGAX_MODE_256x240 15KB. A 
+ * framebuffer byte holds 4 pixels, the first one in the 2 high bits. The 
+ * 640 and 800 pixels modes are not available: 5 to 7 chunks for each line,
+ * more than the 4 chunks of ESPVGAX_BPP 4, and a 37.5 to 47KB framebuffer,
+ * that does not fit with the Wifi stack.
+ * With 4 the HSPI sends the pixeldata on 4 pins (quad output, 
+ * SPI_FWRITE_QUAD): each SPI clock puts a pixel of 4 bits, IRGB, on
+ *    bit 0, blue:      D7  (GPIO13, HSPID)
+ *    bit 1, green:     D6  (GPIO12, HSPIQ)
+ *    bit 2, red:       SD3 (GPIO10, HSPIWP)
+ *    bit 3, intensity: SD2 (GPIO9,  HSPIHD)
+ * so every pixel can have one of 16 colors (see ESPVGAX_BLACK..ESPVGAX_WHITE).
+ * The pixel clock does not change, but the framebuffer is 4 times bigger and
+ * the line is sent in 4 chunks of 64 pixels, like the wide modes. Only
+ * ESPVGAX_MODE_256x240 is available (30KB), use a framebuffer window with
+ * less rows to save RAM. A framebuffer byte holds 2 pixels, the first one in
+ * the high nibble.
+ *
+ * WARNING: GPIO9 and GPIO10 are the flash data pins 2 and 3 (SD_DATA2 and
+ *  SD_DATA3). With the QIO or QOUT flash mode the next cached read of the
+ *  flash crashes the ESP8266 after begin has muxed them to the HSPI. 
+ *  ESPVGAX_BPP 4 requires the DIO or DOUT flash mode, and a module where 
+ *  these pins are not wired to the flash WP and HOLD pins. Define 
+ *  ESPVGAX_ALLOW_FLASH_PINS to confirm it, otherwise ESPVGAX_BPP 4 does not
+ *  compile
+ */
+#ifndef ESPVGAX_BPP
+#define ESPVGAX_BPP 1
+#endif
+//#define ESPVGAX_ALLOW_FLASH_PINS
+#if ESPVGAX_BPP!=1 && ESPVGAX_BPP!=2 && ESPVGAX_BPP!=4
+#error "ESPVGAX_BPP must be 1, 2 or 4"
+#endif
+#if ESPVGAX_BPP==4 && ESPVGAX_MODE!=ESPVGAX_MODE_256x240
+#error "ESPVGAX_BPP 4 requires ESPVGAX_MODE_256x240"
+#endif
+#if ESPVGAX_BPP==2 && ESPVGAX_MODE>=ESPVGAX_MODE_640x480
+#error "ESPVGAX_BPP 2 is not available with the 640 and 800 pixels modes"
+#endif
+// the host build (ESPVGAX_HOST) does not have a flash
+#if ESPVGAX_BPP==4 && !defined(ESPVGAX_ALLOW_FLASH_PINS) && \
+  !defined(ESPVGAX_HOST)
+#error "ESPVGAX_BPP 4 uses the flash pins GPIO9/10, see ESPVGAX_ALLOW_FLASH_PINS"
+#endif
+// flash mode passed by the ESP8266 Arduino core
+#if ESPVGAX_BPP==4 && (defined(FLASHMODE_QIO) || defined(FLASHMODE_QOUT))
+#error "ESPVGAX_BPP 4 requires the DIO or DOUT flash mode"
+#endif
 
-#define ESPVGAX_WIDTH 512
-#define ESPVGAX_BWIDTH (ESPVGAX_WIDTH/8)
-#define ESPVGAX_WWIDTH (ESPVGAX_WIDTH/32)
-#define ESPVGAX_HEIGHT 480
+// pixels sent for each VGA line
+#if ESPVGAX_MODE==ESPVGAX_MODE_256x240
+#define ESPVGAX_LINE_WIDTH 256
+#elif ESPVGAX_MODE==ESPVGAX_MODE_640x480 || ESPVGAX_MODE==ESPVGAX_MODE_640x240
+#define ESPVGAX_LINE_WIDTH 640
+#elif ESPVGAX_MODE==ESPVGAX_MODE_800x480 || ESPVGAX_MODE==ESPVGAX_MODE_800x240
+#define ESPVGAX_LINE_WIDTH 800
+#else
+#define ESPVGAX_LINE_WIDTH 512
+#endif
+#define ESPVGAX_LINE_WWIDTH (ESPVGAX_LINE_WIDTH*ESPVGAX_BPP/32)
+// VGA lines for each framebuffer line, as power of 2
+#if ESPVGAX_MODE==ESPVGAX_MODE_512x480 || ESPVGAX_MODE==ESPVGAX_MODE_640x480 \
+  || ESPVGAX_MODE==ESPVGAX_MODE_800x480
+#define ESPVGAX_YSHIFT 0
+#else
+#define ESPVGAX_YSHIFT 1
+#endif
+/*
+ * framebuffer window (letterbox). By default the framebuffer covers all the
+ * screen. If only a part of the screen is used, the framebuffer can store
+ * only a window of ESPVGAX_WINDOW_HEIGHT rows, displayed from the VGA line 
+ * ESPVGAX_WINDOW_TOP, and ESPVGAX_WINDOW_WWIDTH columns of 32 bits 
+ * (ESPVGAX_WORD_PIXELS pixels), displayed from the column 
+ * ESPVGAX_WINDOW_LEFT32. The RAM used by the framebuffer scales with the 
+ * window size. All lines and columns outside of the window 
+ * display the 32 bits ESPVGAX_WINDOW_FILL, stored like a fbw word.
+ * ESPVGAX_WIDTH and ESPVGAX_HEIGHT are the window size and all drawing 
+ * primitives clip to it. For example a 512x200 band in the center of the 
+ * screen requires 12.5KB:
+ *    #define ESPVGAX_WINDOW_TOP 140
+ *    #define ESPVGAX_WINDOW_HEIGHT 200
+ */
+#ifndef ESPVGAX_WINDOW_TOP
+#define ESPVGAX_WINDOW_TOP 0
+#endif
+#ifndef ESPVGAX_WINDOW_HEIGHT
+#define ESPVGAX_WINDOW_HEIGHT ((480-ESPVGAX_WINDOW_TOP)>>ESPVGAX_YSHIFT)
+#endif
+#ifndef ESPVGAX_WINDOW_LEFT32
+#define ESPVGAX_WINDOW_LEFT32 0
+#endif
+#ifndef ESPVGAX_WINDOW_WWIDTH
+#define ESPVGAX_WINDOW_WWIDTH (ESPVGAX_LINE_WWIDTH-ESPVGAX_WINDOW_LEFT32)
+#endif
+#ifndef ESPVGAX_WINDOW_FILL
+#define ESPVGAX_WINDOW_FILL 0
+#endif
+#if ESPVGAX_WINDOW_TOP+(ESPVGAX_WINDOW_HEIGHT<<ESPVGAX_YSHIFT)>480 || \
+  ESPVGAX_WINDOW_LEFT32+ESPVGAX_WINDOW_WWIDTH>ESPVGAX_LINE_WWIDTH
+#error "ESPVGAX framebuffer window outside of the screen"
+#endif
+#if ESPVGAX_LINE_WWIDTH>16 && ESPVGAX_WINDOW_WWIDTH!=ESPVGAX_LINE_WWIDTH
+#error "ESPVGAX wide modes require a full width framebuffer window"
+#endif
+
+#define ESPVGAX_WWIDTH ESPVGAX_WINDOW_WWIDTH
+// pixels stored in a fbw word
+#define ESPVGAX_WORD_PIXELS (32/ESPVGAX_BPP)
+#define ESPVGAX_WIDTH (ESPVGAX_WWIDTH*ESPVGAX_WORD_PIXELS)
+#define ESPVGAX_BWIDTH (ESPVGAX_WWIDTH*4)
+#define ESPVGAX_HEIGHT ESPVGAX_WINDOW_HEIGHT
 #define ESPVGAX_FBBSIZE (ESPVGAX_HEIGHT*ESPVGAX_BWIDTH)
 
+// bits of a pixel color, and color of a pixel from the c parameter
+#define ESPVGAX_PIXEL_MASK ((1<<ESPVGAX_BPP)-1)
+#if ESPVGAX_BPP==1
+#define ESPVGAX_PIXEL(c) ((c)>0 ? 1 : 0)
+#else
+#define ESPVGAX_PIXEL(c) ((c) & ESPVGAX_PIXEL_MASK)
+#endif
+// colors of the 4 bits pixels (ESPVGAX_BPP 4)
+#define ESPVGAX_BLACK 0
+#define ESPVGAX_BLUE 1
+#define ESPVGAX_GREEN 2
+#define ESPVGAX_CYAN 3
+#define ESPVGAX_RED 4
+#define ESPVGAX_MAGENTA 5
+#define ESPVGAX_BROWN 6
+#define ESPVGAX_LIGHTGRAY 7
+#define ESPVGAX_DARKGRAY 8
+#define ESPVGAX_LIGHTBLUE 9
+#define ESPVGAX_LIGHTGREEN 10
+#define ESPVGAX_LIGHTCYAN 11
+#define ESPVGAX_LIGHTRED 12
+#define ESPVGAX_LIGHTMAGENTA 13
+#define ESPVGAX_YELLOW 14
+#define ESPVGAX_WHITE 15
+
+// text mode grid size (see ESPVGAX_TEXT_MODE)
+#define ESPVGAX_TEXT_COLS (ESPVGAX_WIDTH/8)
+#define ESPVGAX_TEXT_ROWS (ESPVGAX_HEIGHT/ESPVGAX_TEXT_FONT_HEIGHT)
+// text mode attribute bits (see ESPVGAX::textAttr)
+#define ESPVGAX_ATTR_INVERSE 1
+#define ESPVGAX_ATTR_UNDERLINE 2
+
 #define ESPVGAX_HSYNC_PIN D2 
 #define ESPVGAX_VSYNC_PIN D1 
 #define ESPVGAX_COLOR_PIN D7 //cannot be changed. D7=GPIO13, used by HSPI
@@ -70,6 +250,217 @@ hardware wiring and library usage.
  * WARNING: TIMER0 works only at 80MHz
  */
 #define ESPVGAX_TIMER 1
+/*
+ * enable vga_handler statistics, see ESPVGAX::getStats. The duration of every
+ * vga_handler call is measured with the CCOUNT register, this cost about 50
+ * CPU cycles for each VGA line
+ */
+//#define ESPVGAX_STATS
+// number of bars of the vga_handler duration histogram (see ESPVGAX::Stats)
+#define ESPVGAX_STATS_BINS 16
+/*
+ * a vga_handler call is counted as late when it starts more than this number
+ * of CPU cycles after the expected timer tick. 4 CPU cycles at 80MHz are one
+ * pixel
+ */
+#define ESPVGAX_STATS_LATE_CYCLES 8
+/*
+ * enable double buffering (see ESPVGAX::flip). A second framebuffer is 
+ * allocated: fbw and fbb point to the back buffer, where all drawing 
+ * primitives write, while vga_handler reads the front buffer. Keep in mind
+ * that two 512x480 framebuffers require 60KB of RAM
+ */
+//#define ESPVGAX_DOUBLE_BUFFER
+/*
+ * enable the dirty map (see ESPVGAX::commit), requires ESPVGAX_DOUBLE_BUFFER.
+ * The drawing primitives mark the 32bit words of the back buffer they write,
+ * one bit for each word of a line (4 bytes of RAM for each line, then at most
+ * 32 words for each line), and commit copies only the marked words to the 
+ * displayed buffer
+ */
+//#define ESPVGAX_DIRTY_MAP
+#if defined(ESPVGAX_DIRTY_MAP) && !defined(ESPVGAX_DOUBLE_BUFFER)
+#error "ESPVGAX_DIRTY_MAP requires ESPVGAX_DOUBLE_BUFFER"
+#endif
+#if defined(ESPVGAX_DIRTY_MAP) && ESPVGAX_WWIDTH>32
+#error "ESPVGAX_DIRTY_MAP supports at most 32 words for each line"
+#endif
+/*
+ * enable the display list (see ESPVGAX::setDisplayRow). vga_handler will read
+ * the framebuffer row to be displayed, for each VGA line, from a table of 480
+ * entries (960 bytes of RAM), instead of displaying the framebuffer rows in
+ * order. Vertical scrolling, split screens and rows duplication can be done
+ * changing the table, without moving the framebuffer content
+ */
+//#define ESPVGAX_DISPLAY_LIST
+/*
+ * enable horizontal scrolling of each VGA line (see ESPVGAX::setLineScroll).
+ * vga_handler copies the line, rotated, to the HSPI during the HSYNC pulse.
+ * This require about 160 CPU cycles for each line (hidden in the HSYNC pulse,
+ * that is 305 CPU cycles at 80MHz) and 960 bytes of RAM
+ */
+//#define ESPVGAX_HSCROLL
+/*
+ * store the framebuffer words in the native order of the CPU: bit 31 of 
+ * fbw[y][0] is the leftmost pixel (see ESPVGAX_PIXELS32).
+ * The HSPI sends the W registers from the most significant byte 
+ * (SPI_WR_BYTE_ORDER), so the drawing primitives do not swap the framebuffer
+ * words. The images and the fonts keep their format, a byte stream with the 
+ * leftmost pixel in the most significant bit: the blits swap only the source
+ * words. fbb is still a byte alias of fbw, use ESPVGAX_FBB_INDEX to address
+ * it and ESPVGAX_FBW_BIG_ENDIAN to convert the big endian words written by
+ * code made for the default order. Not available with the text and tile 
+ * modes
+ */
+//#define ESPVGAX_NATIVE_ORDER
+/*
+ * ESPVGAX_PIXELS32(w)
+ *    convert the fbw word w to a 32 pixels word, with the leftmost pixel in 
+ *    the most significant bits, and back
+ * ESPVGAX_FBW_BIG_ENDIAN(w)
+ *    convert the big endian word w (the byte order of fbb, of the images and
+ *    of fbw without ESPVGAX_NATIVE_ORDER) to a fbw word, and back
+ * ESPVGAX_FBB_INDEX(i)
+ *    index of fbb that holds the i-th byte of the framebuffer, in display 
+ *    order
+ */
+#ifdef ESPVGAX_NATIVE_ORDER
+#define ESPVGAX_PIXELS32(w) ((uint32_t)(w))
+#define ESPVGAX_FBW_BIG_ENDIAN(w) SWAP_UINT32((uint32_t)(w))
+#define ESPVGAX_FBB_INDEX(i) ((i) ^ 3)
+#else
+#define ESPVGAX_PIXELS32(w) SWAP_UINT32((uint32_t)(w))
+#define ESPVGAX_FBW_BIG_ENDIAN(w) ((uint32_t)(w))
+#define ESPVGAX_FBB_INDEX(i) (i)
+#endif
+/*
+ * enable ESPVGAX_OVERLAYS overlay sprites, like mouse and text cursors (see 
+ * ESPVGAX::setOverlay). vga_handler merges them in a copy of the next line, 
+ * so they are displayed over the framebuffer without writing it. This 
+ * require about 60 CPU cycles for each line with an overlay, plus 30 for 
+ * each overlay of the line, and 2 lines of RAM. At 80MHz the wide modes
+ * leave time for only 2 overlays (and none with the text mode): check your
+ * configuration with tools/host/vgasim
+ */
+//#define ESPVGAX_OVERLAYS 2
+/*
+ * enable the text mode (see ESPVGAX::text). The framebuffer is not 
+ * allocated: RAM holds only a grid of characters, ESPVGAX_TEXT_COLS x
+ * ESPVGAX_TEXT_ROWS cells of 8 x ESPVGAX_TEXT_FONT_HEIGHT pixels that cover
+ * the framebuffer window, and a copy of the font glyphs (256 x 
+ * ESPVGAX_TEXT_FONT_HEIGHT bytes). vga_handler composes each line from the
+ * glyphs, after the pixeldata of the previous line has been sent. This 
+ * require about 16 CPU cycles for each 32 pixels of the line. The drawing 
+ * primitives (fbw, blit, print, etc..) are not available. For example 64x40
+ * characters with a 12 pixels font require 5.6KB instead of 30KB. The 800
+ * pixels modes require the CPU at 160MHz
+ */
+//#define ESPVGAX_TEXT_MODE
+// height of the text mode font, and of the character cells
+#ifndef ESPVGAX_TEXT_FONT_HEIGHT
+#define ESPVGAX_TEXT_FONT_HEIGHT 12
+#endif
+/*
+ * enable an attribute byte for each character of the text mode (see 
+ * ESPVGAX::textAttr)
+ */
+//#define ESPVGAX_TEXT_ATTRIBUTES
+/*
+ * enable the tile mode (see ESPVGAX::tileMap). Like the text mode, the 
+ * framebuffer is not allocated and vga_handler composes each line: from a
+ * map of ESPVGAX_TILEMAP_COLS x ESPVGAX_TILEMAP_ROWS tiles (8 x 
+ * ESPVGAX_TILE_HEIGHT pixels) of a tile set of ESPVGAX_TILES tiles, scrolled 
+ * by any number of pixels, plus ESPVGAX_SPRITES sprites of 16 pixels wide. 
+ * At most ESPVGAX_LINE_SPRITES sprites are drawn on each line, so the time
+ * needed to compose a line is bounded. A 64x60 map with 256 tiles of 8x8 
+ * pixels requires 5.9KB. The 640 pixels modes require the CPU at 160MHz, 
+ * the 800 pixels modes are not available
+ */
+//#define ESPVGAX_TILE_MODE
+#ifndef ESPVGAX_TILE_HEIGHT
+#define ESPVGAX_TILE_HEIGHT 8
+#endif
+#ifndef ESPVGAX_TILES
+#define ESPVGAX_TILES 256
+#endif
+#ifndef ESPVGAX_TILEMAP_COLS
+#define ESPVGAX_TILEMAP_COLS (ESPVGAX_WIDTH/8)
+#endif
+#ifndef ESPVGAX_TILEMAP_ROWS
+#define ESPVGAX_TILEMAP_ROWS (ESPVGAX_HEIGHT/ESPVGAX_TILE_HEIGHT)
+#endif
+#ifndef ESPVGAX_SPRITES
+#define ESPVGAX_SPRITES 8
+#endif
+#ifndef ESPVGAX_LINE_SPRITES
+#define ESPVGAX_LINE_SPRITES 4
+#endif
+
+#if defined(ESPVGAX_TEXT_MODE) || defined(ESPVGAX_TILE_MODE)
+// the lines are composed by vga_handler, there is no framebuffer
+#define ESPVGAX_NO_FRAMEBUFFER
+#endif
+#ifdef ESPVGAX_NO_FRAMEBUFFER
+#if defined(ESPVGAX_TEXT_MODE) && defined(ESPVGAX_TILE_MODE)
+#error "ESPVGAX_TEXT_MODE and ESPVGAX_TILE_MODE cannot be used together"
+#endif
+#if ESPVGAX_BPP!=1
+#error "ESPVGAX text and tile modes require ESPVGAX_BPP 1"
+#endif
+#ifdef ESPVGAX_DOUBLE_BUFFER
+#error "ESPVGAX text and tile modes have no framebuffer, undefine ESPVGAX_DOUBLE_BUFFER"
+#endif
+#ifdef ESPVGAX_NATIVE_ORDER
+#error "ESPVGAX text and tile modes have no framebuffer, undefine ESPVGAX_NATIVE_ORDER"
+#endif
+// the 800 pixels lines leave no time to compose the next one at 80MHz
+#if ESPVGAX_LINE_WIDTH==800 && defined(F_CPU) && F_CPU<160000000L
+#error "ESPVGAX text and tile modes with the 800 pixels modes require the CPU at 160MHz"
+#endif
+#if ESPVGAX_TILES>256
+#error "ESPVGAX_TILES must be at most 256"
+#endif
+#ifdef ESPVGAX_TILE_MODE
+#if ESPVGAX_LINE_WIDTH==800
+#error "ESPVGAX_TILE_MODE is not available with the 800 pixels modes"
+#endif
+#if ESPVGAX_LINE_WIDTH==640 && defined(F_CPU) && F_CPU<160000000L
+#error "ESPVGAX_TILE_MODE with the 640 pixels modes requires the CPU at 160MHz"
+#endif
+#endif
+#endif
+/*
+ * enable the HSPI transfer done interrupt (SPI_TRANS_DONE). As soon as a line 
+ * has been shifted out, the interrupt copies the next one to the HSPI W 
+ * registers, so vga_handler does not copy it during the HSYNC pulse. This 
+ * happens only if the interrupt (about 170 CPU cycles) ends before the timer
+ * interrupt of the next line is raised, that needs a front porch of about 
+ * 3us: with the VESA and VGA timings the pixeldata ends in the 0.6us front
+ * porch, and the lines are still copied during HSYNC. Use it with 
+ * TIMING_640x480_55. See README. Not available with the wide modes and with
+ * ESPVGAX_HSCROLL
+ */
+//#define ESPVGAX_SPI_PIPELINE
+#ifdef ESPVGAX_SPI_PIPELINE
+#if ESPVGAX_LINE_WWIDTH>16
+#error "ESPVGAX_SPI_PIPELINE is not available with the wide modes"
+#endif
+#ifdef ESPVGAX_HSCROLL
+#error "ESPVGAX_SPI_PIPELINE is not available with ESPVGAX_HSCROLL"
+#endif
+#endif
+/*
+ * CPU cycles added between two 256 pixels chunks of the wide modes, after 
+ * the end of the first one. Increase it if the HSPI needs more time to 
+ * restart (see tools/host/vgasim for the seam measure)
+ */
+#define ESPVGAX_SEAM_CYCLES 0
+// max number of raster line callbacks (see ESPVGAX::setLineCallback)
+#define ESPVGAX_LINE_CALLBACKS 8
+
+// sync pulses polarity bits (see ESPVGAX::ModeTiming), 0 is negative
+#define ESPVGAX_HSYNC_POSITIVE 1
+#define ESPVGAX_VSYNC_POSITIVE 2
 
 // BITWISE operations, used by drawing primitives
 #define ESPVGAX_OP_OR 1
@@ -82,18 +473,68 @@ hardware wiring and library usage.
 // data aligned on 32bit memory. needed to use pgm_read_dword
 #define ESPVGAX_ALIGN32 __attribute__ ((aligned(4)))
 
+// mark the written words in the dirty map (see ESPVGAX::markDirty)
+#ifdef ESPVGAX_DIRTY_MAP
+#define ESPVGAX_MARK_DIRTY(x32, y) ESPVGAX::dirty[y]|=1u<<(x32)
+#define ESPVGAX_MARK_DIRTY_RECT(x, y, w, h) ESPVGAX::markDirty(x, y, w, h)
+#else
+#define ESPVGAX_MARK_DIRTY(x32, y)
+#define ESPVGAX_MARK_DIRTY_RECT(x, y, w, h)
+#endif
+
 // ESPVGAX static class
 class ESPVGAX {
 public:
+  /*
+   * ModeTiming
+   *    VGA signal timing: the HSYNC pulse and the back porch are measured in
+   *    pixels of pixelClock (Hz), the VSYNC pulse in lines. VSYNC begins at
+   *    line vSyncStart and ends at line vSyncEnd. Only the first vActive 
+   *    lines display the framebuffer (see ESPVGAX_WINDOW_TOP), the pixeldata
+   *    is centered in the hActive pixels. The HSPI clock is 80MHz divided by
+   *    an integer, so a line of 512 or 256 pixels lasts 25.6us, a little more
+   *    than the 25.42us of the 640 active pixels at 25.175MHz: it begins 2
+   *    pixels before the end of the back porch and ends 2 pixels after the
+   *    beginning of the front porch (8 pixels with the 4 chunks of 
+   *    ESPVGAX_BPP 4), still far from the sync pulses. Monitors show them as
+   *    a slightly wider picture. The line period (hTotal pixels) is
+   *    converted to CPU cycles with a 16 bits fractional part, so the 
+   *    average line and frame rate are exact. Available timings:
+   *      TIMING_640x480_60: VESA 640x480@60Hz, the default
+   *      TIMING_640x400_70: VGA 640x400@70Hz, VSYNC positive
+   *      TIMING_640x350_70: VGA 640x350@70Hz, HSYNC positive
+   *      TIMING_640x480_55: 640x480@55.5Hz, the VESA 640x480 timing with 64
+   *        more pixels in the front porch (hTotal 864, 29.1KHz line rate), 
+   *        for ESPVGAX_SPI_PIPELINE. Not a VESA timing: most multisync 
+   *        monitors accept it, check yours
+   *    The framebuffer resolution does not change: 640x400 displays only the 
+   *    first 400 framebuffer lines (200 with ESPVGAX_YSHIFT=1)
+   */
+  struct ModeTiming {
+    uint32_t pixelClock;
+    uint16_t hTotal, hActive, hSync, hBackPorch;
+    uint16_t vTotal, vActive, vSyncStart, vSyncEnd;
+    uint8_t polarity;
+  };
+  static const ModeTiming TIMING_640x480_60;
+  static const ModeTiming TIMING_640x400_70;
+  static const ModeTiming TIMING_640x350_70;
+  static const ModeTiming TIMING_640x480_55;
   /* 
-   * begin()
+   * begin(timing)
    * end()
    *    install/uninstall VGA signal generation. Depending on ESPVGAX_TIMER
    *    hardware timer1 or timer2 will be used.
    *    begin method will setup HSPI data transmission on PINS D5,D6,D7,D8 
+   *    and generate the VGA signal with the given timing
    */
-  static void begin();
+  static void begin(const ModeTiming &timing=TIMING_640x480_60);
   static void end();
+  /*
+   * getModeTiming()
+   *    return the timing of the VGA signal, set by begin
+   */
+  static const ModeTiming &getModeTiming();
   /* 
    * pause()
    * resume()
@@ -108,6 +549,150 @@ public:
    */
   static void pause();
   static void resume();
+  /*
+   * flip()
+   *    swap the front and the back framebuffers, available only if
+   *    ESPVGAX_DOUBLE_BUFFER is defined. The swap is done by vga_handler at
+   *    the beginning of the vertical blank (line vActive), so the frame is never
+   *    displayed half drawed. flip waits for the swap, then fbw and fbb point
+   *    to the new back buffer, that contains the frame displayed before the
+   *    swap. If the VGA signal is not running (see begin) the swap is done
+   *    immediately
+   */
+  static void flip();
+  /*
+   * commit()
+   *    copy the words of the back buffer marked in the dirty map to the 
+   *    front buffer, then clear the map. Available only if ESPVGAX_DIRTY_MAP
+   *    is defined. commit waits for the beginning of the vertical blank, so 
+   *    small updates are never displayed half drawed. Unlike flip, the back
+   *    buffer is not swapped and keeps the whole frame: draw only what 
+   *    changes, then call commit. Do not mix commit and flip, flip clears the
+   *    dirty map
+   * markDirty(x, y, w, h)
+   *    mark a rectangle of pixels in the dirty map. All drawing primitives 
+   *    mark the words they write, call markDirty only after writing directly
+   *    to fbw or fbb
+   */
+  static void commit();
+  static void markDirty(int x, int y, int w, int h);
+  /*
+   * waitVSync()
+   * waitLine(y)
+   * currentLine()
+   * frameCount()
+   *    synchronize the sketch with the VGA signal. waitVSync waits for the
+   *    beginning of the vertical blank, when the last visible line 
+   *    (ModeTiming::vActive-1) has been copied to the HSPI. Lines 480..524 of
+   *    640x480 are not visible, so you have about 1.4ms to update the 
+   *    framebuffer without flicker. waitLine waits for the VGA line y 
+   *    (0..vTotal-1) to begin. currentLine returns the VGA line
+   *    that is being sent. frameCount returns the number of VGA frames sent
+   *    from begin, incremented at the beginning of each vertical blank.
+   *    waitVSync and waitLine return immediately if the VGA signal is not
+   *    running (see begin)
+   */
+  static void waitVSync();
+  static void waitLine(int y);
+  static int currentLine();
+  static uint32_t frameCount();
+  /*
+   * setLineCallback(y, cb)
+   *    register a function that vga_handler will call at every frame, when
+   *    the VGA line y (0..vTotal-1) is going to be fetched. The callback runs
+   *    inside the interrupt handler, after the pixeldata of line y-1 has been
+   *    passed to the HSPI and before the framebuffer row y is read, so it can
+   *    change the line properties (setLineProp) of line y, the content of row
+   *    y or the other VGA settings that take effect from line y. Only one
+   *    callback can be registered for each line, cb=0 removes it. Up to
+   *    ESPVGAX_LINE_CALLBACKS callbacks can be registered.
+   *    return false if the callback cannot be registered, or if y is not a
+   *    line of the timing passed to begin (vTotal is 449 with 640x400 and
+   *    640x350). begin drops the callbacks of the lines after its vTotal
+   *
+   *    WARNING: callbacks run inside an interrupt: they must be declared with
+   *      ICACHE_RAM_ATTR and must be very short (a few hundreds CPU cycles).
+   *      Do not call any Arduino function inside them. For example:
+   *        void ICACHE_RAM_ATTR statusBar(int y) {
+   *          ESPVGAX::setLineProp(y, ESPVGAX_PROP_COLOR1);
+   *        }
+   */
+  typedef void (*LineCallback)(int y);
+  static bool setLineCallback(int y, LineCallback cb);
+  /*
+   * setDisplayRow(y, row)
+   * getDisplayRow(y)
+   * resetDisplayList()
+   * rotateDisplayList(y0, y1, n)
+   *    change the framebuffer row displayed at the VGA line y (0..479). These
+   *    methods work only if ESPVGAX_DISPLAY_LIST is defined. Without a 
+   *    display list, VGA line y displays the row y>>ESPVGAX_YSHIFT.
+   *    setDisplayRow set the row (0..ESPVGAX_HEIGHT-1) displayed at line y,
+   *    getDisplayRow returns it. resetDisplayList set the default table. 
+   *    rotateDisplayList rotates the table entries of the lines y0..y1-1, so 
+   *    that line y displays the row that was displayed at line y+n (n>0 
+   *    scroll the content up, n<0 down). Rows that exit on one side enter
+   *    from the other side. For example a log viewer with a 16 lines status
+   *    bar at the bottom can add a text line with:
+   *      ESPVGAX::rotateDisplayList(0, 464, 8);
+   *      int row=ESPVGAX::getDisplayRow(456);
+   *      // draw the new text line at framebuffer rows row..row+7
+   *
+   *    NOTE: the table is read by vga_handler while the sketch changes it.
+   *      To change many entries without tearing, call waitVSync before
+   *    NOTE(2): y0, y1 and n are VGA lines. With ESPVGAX_YSHIFT=1, use even
+   *      values to keep the framebuffer rows doubled
+   */
+  static void setDisplayRow(int y, int row);
+  static int getDisplayRow(int y);
+  static void resetDisplayList();
+  static void rotateDisplayList(int y0, int y1, int n);
+  /*
+   * setLineScroll(y, offset)
+   * setLinesScroll(start, end, offset)
+   * getLineScroll(y)
+   *    set/get the horizontal scroll of the VGA line y (0..479). These 
+   *    methods work only if ESPVGAX_HSCROLL is defined. The line y displays
+   *    the framebuffer row rotated left by offset pixels (0..ESPVGAX_WIDTH-1,
+   *    other values are wrapped): the pixel x of the screen is the pixel
+   *    (x+offset)%ESPVGAX_WIDTH of the row. The framebuffer is not changed, so
+   *    a ticker or a parallax background costs only one setLinesScroll call
+   *    for each frame.
+   *    The default offset of all lines is 0
+   */
+  static void setLineScroll(int y, int offset);
+  static void setLinesScroll(int start, int end, int offset);
+  static int getLineScroll(int y);
+  /*
+   * setOverlay(n, bitmap, height, mask, op)
+   * moveOverlay(n, x, y)
+   * hideOverlay(n)
+   *    overlay sprites, displayed over the framebuffer window without 
+   *    changing the framebuffer. These methods work only if ESPVGAX_OVERLAYS
+   *    is defined, n is 0..ESPVGAX_OVERLAYS-1. Moving a cursor is only a 
+   *    moveOverlay call, there is nothing to erase and nothing to redraw.
+   *
+   *    parameter bitmap has height lines of ESPVGAX_WORD_PIXELS pixels (32 
+   *      with ESPVGAX_BPP 1), one 32bit word for each line with the leftmost
+   *      pixel in the most significant bits. It must stay in RAM while the
+   *      overlay is displayed
+   *    parameter mask has the format of bitmap, or is 0. With ESPVGAX_OP_SET
+   *      the pixels of the mask are replaced with the pixels of bitmap and 
+   *      the others are transparent (a mask of 0 replaces all pixels)
+   *    parameter op is one of the ESPVGAX_OP_* constant: the bitwise 
+   *      operation between the framebuffer and bitmap. ESPVGAX_OP_XOR draws
+   *      a cursor visible over any background
+   *    parameters x,y of moveOverlay are the position of the top left pixel
+   *      in the framebuffer window, the overlay is displayed after the first
+   *      moveOverlay call. x,y are screen positions: the overlays are not 
+   *      moved by the display list or by the horizontal scroll.
+   *    Overlays are merged in order, so overlay n is displayed over the 
+   *    overlays before it
+   */
+  static void setOverlay(int n, const uint32_t *bitmap, int height, 
+    const uint32_t *mask=0, int op=ESPVGAX_OP_XOR);
+  static void moveOverlay(int n, int x, int y);
+  static void hideOverlay(int n);
   /*
    * setLineProp(y, prop)
    * setLinesProp(start, end, prop)
@@ -115,10 +700,123 @@ public:
    *    get/set orizzontal line properties. prop parameter must be a bitwise OR
    *    of ESPVGAX_PROP_* constants. For example, ESPVGAX_PROP_COLOR1 will turn
    *    ON the output pin ESPVGAX_EXTRA_COLOR1_PIN for the selected line (y)
+   *
+   *    NOTE: y is the VGA line (0..479), not the framebuffer row: with 
+   *      ESPVGAX_YSHIFT=1 each row has two lines, that can have different
+   *      properties, and the lines outside of the framebuffer window can 
+   *      have properties too
    */
   static void setLineProp(int y, uint8_t prop);
   static void setLinesProp(int start, int end, uint8_t prop);
   static uint8_t getLineProp(int y);
+  /*
+   * getStats(stats)
+   * resetStats()
+   *    read/reset the vga_handler statistics. Statistics are collected only
+   *    if ESPVGAX_STATS is defined, otherwise getStats will return all zeros.
+   *    All durations are in CPU cycles, measured with the CCOUNT register,
+   *    from the first to the last instruction of vga_handler (HSPI_wait spin,
+   *    copy of the pixeldata into the HSPI registers and extra colors writes 
+   *    are included, interrupt entry and exit are not).
+   *
+   *    getStats can be called from the main loop at any time: interrupts are
+   *    not disabled, the copy is repeated if vga_handler runs in the middle of
+   *    it. resetStats is executed by vga_handler at the next VGA line
+   *
+   *    Stats members:
+   *      lines: number of vga_handler calls
+   *      frames: number of VGA frames completed
+   *      lineCycles: CPU cycles between two vga_handler calls (one VGA line)
+   *      minCycles, maxCycles, sumCycles: min, max and sum of the vga_handler
+   *        durations. The average duration is sumCycles/lines
+   *      histogram: number of vga_handler calls for each duration range. Each
+   *        bar is lineCycles/ESPVGAX_STATS_BINS wide, the last bar counts also
+   *        the calls longer than one VGA line
+   *      lateLines: number of vga_handler calls started more than 
+   *        ESPVGAX_STATS_LATE_CYCLES after the expected timer tick. These
+   *        lines are shifted horizontally (jitter/flicker)
+   *      maxLate: max delay of a late line
+   *      overrunFrames: number of frames with at least one late line or one
+   *        vga_handler call longer than a VGA line
+   *      waitCycles: part of sumCycles spent in the busy waits for the end 
+   *        of the HSYNC pulse and for the beginning of the pixeldata (see
+   *        ESPVGAX::frameISRCycles)
+   */
+  class Stats {
+  public:
+    uint32_t lines, frames, lineCycles;
+    uint32_t minCycles, maxCycles;
+    uint64_t sumCycles, waitCycles;
+    uint32_t histogram[ESPVGAX_STATS_BINS];
+    uint32_t lateLines, maxLate, overrunFrames;
+  };
+  static void getStats(Stats &stats);
+  static void resetStats();
+  /*
+   * ticks()
+   * frameCycles()
+   * frameISRCycles()
+   * frameFreeCycles()
+   * frameSavedCycles()
+   * isrCycles()
+   *    CPU cycles budget of a VGA frame. ticks returns the CCOUNT register.
+   *    frameCycles is the number of CPU cycles of a VGA frame (vTotal lines),
+   *    frameISRCycles is the number of CPU cycles used by vga_handler in the
+   *    last complete frame and frameFreeCycles are the CPU cycles left to
+   *    your sketch in the same frame. frameSavedCycles is the number of CPU 
+   *    cycles saved in the last complete frame by the vertical blank lines, 
+   *    that do not use the HSPI, compared with a line that sends pixeldata.
+   *    isrCycles is the number of CPU cycles used by vga_handler since begin
+   *    (wraps around every 2^32 cycles).
+   *
+   *    NOTE: interrupt entry and exit are not measured (about 100 CPU cycles
+   *      for each VGA line), so frameFreeCycles is a little optimistic
+   *
+   *    NOTE(2): vga_handler begins the HSYNC pulse and busy waits for its end
+   *      and for the end of the back porch, then starts the pixeldata. With
+   *      the VESA timings they last 5.7us, 456 CPU cycles at 80MHz, about 
+   *      18% of each line with pixeldata. frameISRCycles includes them, the
+   *      part of vga_handler spent waiting is Stats::waitCycles
+   */
+  static uint32_t ticks();
+  static uint32_t frameCycles();
+  static uint32_t frameISRCycles();
+  static inline uint32_t frameFreeCycles() {
+    return frameCycles()-frameISRCycles(); }
+  static uint32_t frameSavedCycles();
+  static uint32_t isrCycles();
+  /*
+   * Budget(result)
+   *    measure the CPU cycles used by a block of code, without the cycles
+   *    used by vga_handler while the block runs. For example:
+   *      {
+   *        ESPVGAX::Budget b;
+   *        ESPVGAX::print_P(str, 0, 0);
+   *        Serial.println(b.percent());
+   *      }
+   *    will print the percent of the frame budget (frameFreeCycles) used to
+   *    draw the string. If result is not zero, the number of CPU cycles used
+   *    is written to *result when the Budget object goes out of scope.
+   *
+   *    cycles() return the CPU cycles used since the Budget was created
+   *    percent() return the percent of frameFreeCycles used since the Budget
+   *      was created. Can be more than 100 if the block requires more than
+   *      one VGA frame
+   */
+  class Budget {
+  public:
+    Budget(uint32_t *result=0) : result(result) { 
+      isr=isrCycles(); start=ticks(); }
+    ~Budget() { 
+      if (result) *result=cycles(); }
+    uint32_t cycles() const { 
+      uint32_t t=ticks()-start; return t-(isrCycles()-isr); }
+    uint32_t percent() const { 
+      return (uint64_t)cycles()*100/frameFreeCycles(); }
+  private:
+    uint32_t *result;
+    uint32_t start, isr;
+  };
   /*
    * delay(msec)
    * rand()
@@ -130,25 +828,41 @@ public:
   static void delay(uint32_t msec);
   static uint32_t rand();
   static void srand(uint32_t seed);
+#ifndef ESPVGAX_NO_FRAMEBUFFER
   /*
    * clear(c8)
    *    fast clear of VGA framebuffer. c8 parameter is used to fill 8 pixels 
    *    with cleared value. For example 0xff will turn 8 pixel on, 0xf0 will 
-   *    turn 4 pixels on and 4 off
+   *    turn 4 pixels on and 4 off. With ESPVGAX_BPP 2 c8 fills 4 pixels, with
+   *    ESPVGAX_BPP 4 2 pixels: for example 0x11 clears the framebuffer with
+   *    ESPVGAX_BLUE
    */
   static inline void clear(uint8_t c8=0) { 
-    memset((void*)fbw, c8, ESPVGAX_FBBSIZE); }
+    memset((void*)fbw, c8, ESPVGAX_FBBSIZE); 
+    ESPVGAX_MARK_DIRTY_RECT(0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT); }
   /*
    * copy_P(from)
    * copy  (from)
    *    fast copy from a buffer in RAM or in FLASH to VGA framebuffer. Use the
    *    copy_P function is your buffer is stored in FLASH.
    */
+#ifdef ESPVGAX_NATIVE_ORDER
+  // the words of the buffer are swapped by blit
+  static inline void copy_P(ESPVGAX_PROGMEM uint8_t *from) { 
+    blit_P(from, 0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT); }
+
+  static inline void copy(uint8_t *from) { 
+    blit(from, 0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT); }
+#else
   static inline void copy_P(ESPVGAX_PROGMEM uint8_t *from) { 
-    memcpy_P((void*)fbb, (void*)from, ESPVGAX_FBBSIZE); }
+    memcpy_P((void*)fbb, (void*)from, ESPVGAX_FBBSIZE); 
+    ESPVGAX_MARK_DIRTY_RECT(0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT); }
 
   static inline void copy(uint8_t *from) { 
-    memcpy((void*)fbw, (void*)from, ESPVGAX_FBBSIZE); }
+    memcpy((void*)fbw, (void*)from, ESPVGAX_FBBSIZE); 
+    ESPVGAX_MARK_DIRTY_RECT(0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT); }
+#endif
+#endif
   /*
    * isYOutside  (y  )
    * isXOutside  (x  )
@@ -172,6 +886,7 @@ public:
 
   static inline bool isXOutside32(int x32) { 
     return x32<0 || x32>=ESPVGAX_WWIDTH; }
+#ifndef ESPVGAX_NO_FRAMEBUFFER
   /*
    * putpixel  (x,   y, c,   op)
    * putpixel8 (x8,  y, c8,  op)
@@ -180,15 +895,20 @@ public:
    *    slow compared to methods that draws multiple pixels at a time, but in
    *    some drawing primitives this is the simplest way to draw a single pixel.
    *
-   *    parameter c is the color of the pixel to be set (1 on, 0 off).
+   *    parameter c is the color of the pixel to be set (1 on, 0 off). With
+   *      ESPVGAX_BPP 2 or 4 c is a color between 0 and ESPVGAX_PIXEL_MASK
    *    parameter op can be one of the ESPVGAX_OP_* constants and will select
    *      the bitwise operation used to put the pixel.
    *
    *    WARNING: putpixel8 and putpixel32 are optimized for write 8 pixels and
    *      32 pixels at a time. For these methods you must use x coordinates 
-   *      expressed in bytes (putpixel8) or 32bit words (putpixel32)
+   *      expressed in bytes (putpixel8) or 32bit words (putpixel32). With
+   *      ESPVGAX_BPP 2 or 4 a byte holds 8/ESPVGAX_BPP pixels and a 32bit word
+   *      holds ESPVGAX_WORD_PIXELS pixels
    *
    *    WARNING(2): in *32 methods c32 must bytes must be in big endian order!
+   *      With ESPVGAX_NATIVE_ORDER c32 is a native word, the leftmost pixel
+   *      in the most significant bits
    */
   static inline void putpixel(int x, int y, uint8_t c, int op=ESPVGAX_OP_SET) {
     #define PUTPIXEL_BASE(x, c, suffix) \
@@ -220,12 +940,15 @@ public:
    *      x32 coordinate equal to 1, if you want to address 64..95 use 2
    *
    *    WARNING(2): in *32 methods c32 must bytes must be in big endian order!
+   *      With ESPVGAX_NATIVE_ORDER c32 is a native word, the leftmost pixel
+   *      in the most significant bits
    */
   static inline void setpixel32(int x32, int y, uint32_t c32) {
     #define WRITE_PIXEL32_BASE(op) \
       if (isXOutside32(x32) || isYOutside(y)) \
         return; \
-      fbw[y][x32] op c32;
+      fbw[y][x32] op c32; \
+      ESPVGAX_MARK_DIRTY(x32, y);
     WRITE_PIXEL32_BASE(=);
   }
   static inline void orpixel32(int x32, int y, uint32_t c32) {
@@ -249,7 +972,8 @@ public:
     #define WRITE_PIXEL8_BASE(op) \
       if (isXOutside8(x8) || isYOutside(y)) \
         return; \
-      fbb[y*ESPVGAX_BWIDTH+x8] op c8;
+      fbb[ESPVGAX_FBB_INDEX(y*ESPVGAX_BWIDTH+x8)] op c8; \
+      ESPVGAX_MARK_DIRTY(x8>>2, y);
     WRITE_PIXEL8_BASE(=);
   }  
   static inline void orpixel8(int x8, int y, uint8_t c8) {
@@ -268,22 +992,21 @@ public:
    */
   static inline void setpixel(int x, int y, uint8_t c) {
     #define WRITE_PIXEL_BASE \
-      uint8_t *p=(uint8_t*)&fbb[y*ESPVGAX_BWIDTH + (x>>3)]; \
-      uint8_t shift=7-(x & 7); \
-      c=c>0?1:0;
+      uint8_t *p=(uint8_t*)&fbb[ESPVGAX_FBB_INDEX(y*ESPVGAX_BWIDTH + \
+        (x*ESPVGAX_BPP>>3))]; \
+      uint8_t shift=8-ESPVGAX_BPP-((x*ESPVGAX_BPP) & 7); \
+      c=ESPVGAX_PIXEL(c); \
+      ESPVGAX_MARK_DIRTY(x*ESPVGAX_BPP>>5, y);
     WRITE_PIXEL_BASE;
-    *p&=~(1<<shift);
+    *p&=~(ESPVGAX_PIXEL_MASK<<shift);
     *p|= (c<<shift);
   }
   static inline void orpixel(int x, int y, uint8_t c) {
     WRITE_PIXEL_BASE;
-    c=c>0?1:0;
     *p|=(c<<shift);
   }
   static inline void xorpixel(int x, int y, uint8_t c) {
     WRITE_PIXEL_BASE;
-    #undef WRITE_PIXEL_BASE
-    c=c>0?1:0;
     *p^=(c<<shift);
     #undef WRITE_PIXEL_BASE
   }
@@ -291,14 +1014,15 @@ public:
    * getpixel(x, y)
    *    x: horizontal pixel coordinate. Must be less than ESPVGAX_WIDTH
    *    y: vertical pixel coordinate. Must be less than ESPVGAX_HEIGHT
-   *    return: 1bit color at <x,y> coordinate
+   *    return: color at <x,y> coordinate (ESPVGAX_BPP bits)
    */
   static inline uint8_t getpixel(int x, int y) {
       if (isXOutside(x) || isYOutside(y))
         return 0;
-      uint8_t *p=(uint8_t*)&fbb[y*ESPVGAX_BWIDTH + (x>>3)];
-      uint8_t shift=7-(x & 7);
-      return ( (*p) >> shift ) & 1;
+      uint8_t *p=(uint8_t*)&fbb[ESPVGAX_FBB_INDEX(y*ESPVGAX_BWIDTH + 
+        (x*ESPVGAX_BPP>>3))];
+      uint8_t shift=8-ESPVGAX_BPP-((x*ESPVGAX_BPP) & 7);
+      return ( (*p) >> shift ) & ESPVGAX_PIXEL_MASK;
   }
   /*
    * blit_P(src, dx, dy, srcw, scrh, op, scrwstride)
@@ -306,7 +1030,10 @@ public:
    *    draw an image at a given coordinate.
    *
    *    parameter src point to the image to be drawed. blit_P method require
-   *      that src data is stored inside FLASH ROM
+   *      that src data is stored inside FLASH ROM. The image has the same
+   *      pixel format of the framebuffer (ESPVGAX_BPP bits for each pixel,
+   *      the first pixel in the most significant bits), each line of pixels
+   *      begins at a byte boundary
    *    parameters dx and dy specify the top left coordinate where the src image 
    *      will be drawed
    *    parameters srcw and srch specify the width and height, in pixels, of the
@@ -320,10 +1047,7 @@ public:
    *      MUST be the width of the bigger image. This value will be used to 
    *      jump from a line of pixels, inside src, to the next line of pixels
    *
-   *    REMARKS: op=ESPVGAX_OP_XOR will work fine ONLY for blit operations that
-   *      has dx and srcw multiples of 32 pixels
-   *
-   *    REMARKS(2): if you need to draw a big image (bigger than half the 
+   *    REMARKS: if you need to draw a big image (bigger than half the 
    *      framebuffer size) some flicker can appear. I have not figured out why
    *      this event appen but it appens. You can choose between the following
    *      solutions to limit screen flickering:
@@ -337,6 +1061,26 @@ public:
 
   static void blit(uint8_t *src, int dx, int dy, int srcw, int srch, 
     int op=ESPVGAX_OP_SET, int srcwstride=0);
+  /*
+   * blitMono_P(src, dx, dy, srcw, srch, fg, bg, op, srcwstride)
+   * blitMono  (src, dx, dy, srcw, srch, fg, bg, op, srcwstride)
+   *    draw a 1bpp image (like the glyphs of the fonts) with the colors fg,
+   *    for the pixels set to 1, and bg, for the pixels set to 0. With 
+   *    ESPVGAX_BPP 1, fg=1 and bg=0 this is the same as blit_P/blit. The 
+   *    other parameters are the same of blit_P/blit. Each line of src is 
+   *    converted to the framebuffer pixel format and clipped, then drawed 
+   *    with blit, so all ops work at every dx.
+   *
+   *    REMARKS: bg is used only by op=ESPVGAX_OP_SET. ESPVGAX_OP_OR and 
+   *      ESPVGAX_OP_XOR do not change the pixels set to 0 in src
+   */
+  static void blitMono_P(ESPVGAX_PROGMEM uint8_t *src, int dx, int dy, 
+    int srcw, int srch, uint8_t fg=ESPVGAX_PIXEL_MASK, uint8_t bg=0, 
+    int op=ESPVGAX_OP_SET, int srcwstride=0);
+
+  static void blitMono(uint8_t *src, int dx, int dy, int srcw, int srch,
+    uint8_t fg=ESPVGAX_PIXEL_MASK, uint8_t bg=0, int op=ESPVGAX_OP_SET, 
+    int srcwstride=0);
   /*
    * setFont(fnt, glyphscount, fntheight, glyphbwidth, hspace, vspace)
    *    set current font for print methods. this method will set a dynamic 
@@ -381,13 +1125,20 @@ public:
    */
   static void setBitmapFont(ESPVGAX_PROGMEM uint8_t *bitmap, uint8_t fntheight,
                             int glyphbwidth=1); 
+  /*
+   * setFontColor(fg, bg)
+   *    set the colors used by print methods to draw the glyphs (see 
+   *    blitMono_P). The default is fg=ESPVGAX_PIXEL_MASK (1, or ESPVGAX_WHITE
+   *    with ESPVGAX_BPP 4) and bg=0
+   */
+  static void setFontColor(uint8_t fg, uint8_t bg=0);
   /*
    * print_P(str, dx, dy, wrap, len, op, bold)
    * print  (str, dx, dy, wrap, len, op, bold) 
    *    draw a string of characters on framebuffer. print_P method requires a
    *    pointer to a string stored in FLASH ROM.
    *    input string will be drawed using the current selected font (bitmap
-   *    font or font with dynamic widths).
+   *    font or font with dynamic widths) and font colors (setFontColor).
    *
    *    parameter str point to the string to be drawed
    *    parameters dx and dy are the (x,y) coordinate where the string will be
@@ -453,6 +1204,46 @@ public:
    */
   static void drawRect(int x, int y, int w, int h, uint8_t c, bool fill=false,
     int op=ESPVGAX_OP_SET);
+  /*
+   * fillRect(x, y, w, h, c, op)
+   * invertRect(x, y, w, h)
+   *    fill the w x h pixels rectangle with top left corner at (x,y), or 
+   *    invert its pixels (all the bits of their colors). The rectangle is 
+   *    clipped once, then each line is written with a masked word at its 
+   *    left and right ends and full 32bit words between them, much faster 
+   *    than single pixels. drawRect uses fillRect when fill is true
+   *
+   *    parameter c is the value of the pixel to be set
+   *    parameter op is one of the ESPVGAX_OP_* constant and specify the bitwise
+   *      operation that will be used to plot pixels
+   */
+  static void fillRect(int x, int y, int w, int h, uint8_t c, 
+    int op=ESPVGAX_OP_SET);
+  static void invertRect(int x, int y, int w, int h);
+  /*
+   * scrollUp(n, c)
+   * scrollDown(n, c)
+   * scrollLeft(n, c)
+   * scrollRight(n, c)
+   *    scroll the whole framebuffer by n pixels, in the direction of the
+   *    method name. The vacated n lines or columns are filled with the color
+   *    c. Vertical scrolls move the lines with a single memmove, horizontal
+   *    scrolls shift each line 32bit word by word, carrying the bits of the
+   *    next word. A negative n scrolls in the opposite direction
+   *
+   * scrollRect(x, y, w, h, dx, dy, c)
+   *    scroll the w x h pixels rectangle with top left corner at (x,y) by dx
+   *    pixels to the right and dy pixels down (negative values scroll to the
+   *    left and up). The pixels outside the rectangle are not changed, and
+   *    the vacated space is filled with the color c (see fillRect). Useful
+   *    for terminal output, chart recorders and scrolling windows
+   */
+  static void scrollUp(int n, uint8_t c=0);
+  static void scrollDown(int n, uint8_t c=0);
+  static void scrollLeft(int n, uint8_t c=0);
+  static void scrollRight(int n, uint8_t c=0);
+  static void scrollRect(int x, int y, int w, int h, int dx, int dy, 
+    uint8_t c=0);
   /*
    * drawLine(x0, y0, x1, y1, c, op)
    *    draw a line
@@ -480,7 +1271,7 @@ public:
   /*
    * fbw[HEIGHT][WWIDTH]
    *    this is the VGA framebuffer! you can write directly to this matrix if
-   *    you needed it.
+   *    you needed it. Its size depends on ESPVGAX_MODE.
    *
    *    WARNING: the number of columns in this matrix is WWIDTH and not WIDTH!
    *      WWIDTH (aka ESPVGAX_WWIDTH) is the number of 32bits words in a line
@@ -495,26 +1286,169 @@ public:
    *        fbw[Y][X]=0x80000000;
    *      If you want you can work in little endian and swap easily to big
    *      endian you can use the SWAP_UINT32 macro. keep in mind that this has
-   *      a costs in terms of CPU cycles
+   *      a costs in terms of CPU cycles. If ESPVGAX_NATIVE_ORDER is defined
+   *      the words are in the native order and 
+   *        fbw[Y][X]=0x80000000;
+   *      sets the leftmost pixel. Code written for the big endian order can 
+   *      use ESPVGAX_FBW_BIG_ENDIAN, that works with both orders:
+   *        fbw[Y][X]=ESPVGAX_FBW_BIG_ENDIAN(0x00000080);
+   *
+   *    WARNING(3): if ESPVGAX_DOUBLE_BUFFER is defined, fbw is a pointer to
+   *      the back buffer and changes at every flip call. Do not keep a copy
+   *      of it
    */
+#ifdef ESPVGAX_DOUBLE_BUFFER
+  static volatile uint32_t (*fbw)[ESPVGAX_WWIDTH];
+#else
   static volatile uint32_t ESPVGAX_ALIGN32 fbw[ESPVGAX_HEIGHT][ESPVGAX_WWIDTH];
+#endif
   /*
    * fbb[HEIGHT*BWIDTH]
    *    this is the VGA framebuffer too! points to the same memory address of
    *    fbw and act as an alias. If you prefer to access 8 pixels at a time,
-   *    instead of 32 pixels at a time, you can use this pointer.
+   *    instead of 32 pixels at a time, you can use this pointer (8/ESPVGAX_BPP
+   *    and ESPVGAX_WORD_PIXELS pixels with ESPVGAX_BPP 2 or 4).
    *
    *    WARNING: the number of columns in this array is BWIDTH and not WIDTH!
    *      BWIDTH (aka ESPVGAX_BWIDTH) is the number of bytes in a line and not 
    *      the number of pixels in a line!
+   *
+   *    WARNING(2): if ESPVGAX_NATIVE_ORDER is defined the bytes of each word
+   *      are reversed. The byte i, in display order, is 
+   *      fbb[ESPVGAX_FBB_INDEX(i)]
    */
   static volatile uint8_t *fbb;
+#ifdef ESPVGAX_DIRTY_MAP
+  /*
+   * dirty[HEIGHT]
+   *    the dirty map (ESPVGAX_DIRTY_MAP): bit i of dirty[y] is set when the
+   *    word fbw[y][i] has been written after the last commit
+   */
+  static uint32_t dirty[ESPVGAX_HEIGHT];
+#endif
+#endif
+#ifdef ESPVGAX_TEXT_MODE
+  /*
+   * text[ROWS][COLS]
+   *    the characters displayed by the text mode (ESPVGAX_TEXT_MODE), 
+   *    ESPVGAX_TEXT_ROWS rows of ESPVGAX_TEXT_COLS characters. Each character
+   *    is an index of the 256 glyphs of the font set by setTextFont. Writing
+   *    a byte of this matrix changes the displayed character, there is not a
+   *    framebuffer to be redrawn.
+   */
+  static volatile uint8_t ESPVGAX_ALIGN32 
+    text[ESPVGAX_TEXT_ROWS][ESPVGAX_TEXT_COLS];
+#ifdef ESPVGAX_TEXT_ATTRIBUTES
+  /*
+   * textAttr[ROWS][COLS]
+   *    the attributes of each character of text, a combination of 
+   *    ESPVGAX_ATTR_INVERSE (swap the pixels of the glyph) and 
+   *    ESPVGAX_ATTR_UNDERLINE (set the last line of the glyph). Available only
+   *    if ESPVGAX_TEXT_ATTRIBUTES is defined
+   */
+  static volatile uint8_t ESPVGAX_ALIGN32 
+    textAttr[ESPVGAX_TEXT_ROWS][ESPVGAX_TEXT_COLS];
+#endif
+  /*
+   * setTextFont(bitmap)
+   *    set the font of the text mode. bitmap has the format of setBitmapFont,
+   *    with glyphs 8 pixels wide and ESPVGAX_TEXT_FONT_HEIGHT pixels tall, 
+   *    for example fonts/monodos12.h with the default font height. The glyphs
+   *    are copied to RAM, so vga_handler does not read the FLASH. Until the
+   *    first call all glyphs are blank
+   */
+  static void setTextFont(ESPVGAX_PROGMEM uint8_t *bitmap);
+  /*
+   * clearText(c, attr)
+   *    fill all text cells with the character c, and with the attributes attr
+   *    if ESPVGAX_TEXT_ATTRIBUTES is defined
+   */
+  static void clearText(uint8_t c=' ', uint8_t attr=0);
+  /*
+   * printText_P(str, col, row, attr)
+   * printText  (str, col, row, attr)
+   *    write a string to the text cells, from the column col of the row row.
+   *    The '\n' character moves to the first column of the next row, a 
+   *    string longer than the row continues on the next one. Characters after
+   *    the last row are not written. Use printText_P if str is stored in 
+   *    FLASH.
+   *
+   *    parameter attr is the attributes of the written characters, used only
+   *      if ESPVGAX_TEXT_ATTRIBUTES is defined
+   */
+  static void printText_P(ESPVGAX_PROGMEM const char *str, int col, int row, 
+    uint8_t attr=0);
+  static void printText(const char *str, int col, int row, uint8_t attr=0);
+#endif
+#ifdef ESPVGAX_TILE_MODE
+  /*
+   * tileMap[ROWS][COLS]
+   *    the map of the tile mode (ESPVGAX_TILE_MODE), ESPVGAX_TILEMAP_ROWS rows
+   *    of ESPVGAX_TILEMAP_COLS tiles. Each byte is the index of a tile of 
+   *    tileSet. The map can be bigger than the screen, see setTileScroll. 
+   *    Writing a byte of this matrix changes the displayed tile
+   */
+  static volatile uint8_t ESPVGAX_ALIGN32 
+    tileMap[ESPVGAX_TILEMAP_ROWS][ESPVGAX_TILEMAP_COLS];
+  /*
+   * tileSet[TILES][TILE_HEIGHT]
+   *    the tiles of the tile mode, 8 pixels wide and ESPVGAX_TILE_HEIGHT 
+   *    pixels tall: one byte for each line of the tile, the most significant
+   *    bit is the leftmost pixel. The tiles are stored in RAM, so vga_handler
+   *    does not read the FLASH. Tiles can be changed at any time, for example
+   *    to animate all the copies of a tile in the map
+   */
+  static uint8_t ESPVGAX_ALIGN32 tileSet[ESPVGAX_TILES][ESPVGAX_TILE_HEIGHT];
+  /*
+   * loadTiles_P(src, first, count)
+   * loadTiles  (src, first, count)
+   *    copy count tiles from src to tileSet, beginning from the tile first. 
+   *    src has the format of tileSet, ESPVGAX_TILE_HEIGHT bytes for each 
+   *    tile. Use loadTiles_P if src is stored in FLASH
+   */
+  static void loadTiles_P(ESPVGAX_PROGMEM uint8_t *src, int first, int count);
+  static void loadTiles(const uint8_t *src, int first, int count);
+  /*
+   * setTileScroll(x, y)
+   *    set the pixel of the map displayed at the top left corner of the 
+   *    framebuffer window. The map wraps around in both directions. Scrolling
+   *    does not write the map: call it after waitVSync to change it between
+   *    two frames
+   */
+  static void setTileScroll(int x, int y);
+  /*
+   * setSprite(n, bitmap, height, mask)
+   *    set the image of the sprite n (0..ESPVGAX_SPRITES-1). bitmap has 
+   *    height lines of 16 pixels, the most significant bit is the leftmost
+   *    pixel. The pixels set in mask are replaced with the pixels of bitmap,
+   *    the others are transparent. If mask is 0 the pixels set in bitmap are
+   *    set and the others are transparent. bitmap and mask must stay in RAM
+   *    while the sprite is displayed. The sprite is hidden until moveSprite
+   *
+   *    NOTE: sprites with a lower n are drawn first, the others are drawn 
+   *      over them. Only the first ESPVGAX_LINE_SPRITES visible sprites of 
+   *      each line are drawn
+   */
+  static void setSprite(int n, const uint16_t *bitmap, int height, 
+    const uint16_t *mask=0);
+  /*
+   * moveSprite(n, x, y)
+   *    display the sprite n with its top left pixel at x,y of the framebuffer
+   *    window. Sprites do not scroll with the map
+   */
+  static void moveSprite(int n, int x, int y);
+  /*
+   * hideSprite(n)
+   *    hide the sprite n
+   */
+  static void hideSprite(int n);
+#endif
   /*
    * tone(uint8_t t)
    * noTone()
    *    Yet unimplemented.
    */
-  static inline void tone(uint8_t t) {}
+  static inline void tone(uint8_t) {}
   static inline void noTone() {}
 };
 #ifndef SWAP_UINT16
@@ -14,7 +14,7 @@
       for (int x32=0; x32!=srcw32; x32++) { \
         if (isXOutside32(dx32+x32)) \
           continue; \
-        dst32[x32] op reader(src32+x32); \
+        dst32[x32] op ESPVGAX_FBW_BIG_ENDIAN(reader(src32+x32)); \
       } \
     } \
     src32+=srcwstride32; \
@@ -53,25 +53,28 @@
           s=reader8(psrc); \
         } \
         s=SWAP_UINT32(s); \
+        /* drop the src bits after the end of the line */ \
+        if (sw<32) \
+          s&=0xffffffff<<(32-sw); \
         /* write s to dst 32bit at a time */ \
         uint32_t dv=*d; \
-        /* swap framebuffer bigendian 32bit word to littleendian 32bit word */ \
-        dv=SWAP_UINT32(dv); \
+        /* framebuffer word to 32 pixels, see ESPVGAX_NATIVE_ORDER */ \
+        dv=ESPVGAX_PIXELS32(dv); \
         uint32_t dmask=0xffffffff; \
         if (sw<32)  \
           dmask<<=32-sw; \
         dmask>>=dshift; \
-        if (!isXOutside(ldx)) { \
+        if (!isXOutside32(ldx>>5)) { \
           loop_code \
-          /* reswap bytes endianess to write back */ \
-          *d=SWAP_UINT32(dv); \
+          /* back to the framebuffer order to write back */ \
+          *d=ESPVGAX_PIXELS32(dv); \
         } \
         if (dshift && sw+pre+dshift>32) { \
           /* save carried bits not writen inside the current 32bit word */ \
           carry=s<<(32-dshift); \
           cmask=0xffffffff<<(32-dshift); \
           if (sw<32)  \
-            cmask<<=sw; \
+            cmask=0xffffffff<<(64-sw-dshift); \
         } else { \
           carry=0; \
           cmask=0; \
@@ -83,11 +86,11 @@
       } \
       if (cmask) {  \
         /* write carried bits, remaining of the last 32bit write of this line */ \
-        if (!isXOutside(ldx) && (uint8_t*)d<fbb+ESPVGAX_FBBSIZE) { \
+        if (!isXOutside32(ldx>>5) && (uint8_t*)d<fbb+ESPVGAX_FBBSIZE) { \
           uint32_t dv=*d; \
-          dv=SWAP_UINT32(dv); \
+          dv=ESPVGAX_PIXELS32(dv); \
           final_code \
-          *d=SWAP_UINT32(dv); \
+          *d=ESPVGAX_PIXELS32(dv); \
         } \
       } \
     } \
@@ -101,10 +104,18 @@
  * functions will be pgm_read_* functions in the case of reading data from 
  * FLASH storage, and will be RAM reading deferencing operator (*) in case of
  * reading data from RAM.
+ * BLIT32 and BLITUNALIGNED move bits: with more than 1 bit per pixel the x
+ * coordinates and the widths are converted to bits (ldx is a bit coordinate)
  */
 #define BLITMETHOD(reader32, reader16, reader8) \
   if (dx>=ESPVGAX_WIDTH || dy>=ESPVGAX_HEIGHT) \
     return; \
+  ESPVGAX_MARK_DIRTY_RECT(dx, dy, srcw, srch); \
+  if (ESPVGAX_BPP>1) { \
+    dx*=ESPVGAX_BPP; \
+    srcw*=ESPVGAX_BPP; \
+    srcwstride*=ESPVGAX_BPP; \
+  } \
   if (srcwstride==0) \
     srcwstride=srcw+(srcw % 8 ? 8-(srcw%8) : 0); \
   if (dx%32==0 && srcw%32==0) { \
@@ -146,3 +157,57 @@ void ESPVGAX::blit(uint8_t *src, int dx, int dy, int srcw, int srch, int op,
   
   BLITMETHOD(*(uint32_t*), *(uint16_t*), *(uint8_t*));
 }
+/*
+ * convert each line of a 1bpp src to the framebuffer pixel format, in a line
+ * buffer, then blit it. Only the columns inside the framebuffer are 
+ * converted
+ */
+#define BLITMONOMETHOD(reader8, blitter) \
+  if (ESPVGAX_BPP==1 && fg==1 && bg==0) \
+    return blitter(src, dx, dy, srcw, srch, op, srcwstride); \
+  if (srcwstride==0) \
+    srcwstride=srcw+(srcw % 8 ? 8-(srcw%8) : 0); \
+  int x0=dx<0 ? -dx : 0; \
+  int x1=dx+srcw>ESPVGAX_WIDTH ? ESPVGAX_WIDTH-dx : srcw; \
+  if (x0>=x1 || dy>=ESPVGAX_HEIGHT) \
+    return; \
+  if (op!=ESPVGAX_OP_SET) \
+    bg=0; \
+  fg=ESPVGAX_PIXEL(fg); \
+  bg=ESPVGAX_PIXEL(bg); \
+  /* blit reads up to 4 bytes after the last pixel */ \
+  uint8_t ESPVGAX_ALIGN32 row[ESPVGAX_BWIDTH+4]; \
+  for (int y=0; y!=srch; y++, src+=srcwstride/8) { \
+    if (isYOutside(dy+y)) \
+      continue; \
+    uint8_t *r=row; \
+    uint8_t b=reader8(src+x0/8); \
+    uint32_t acc=0; \
+    int bits=0; \
+    for (int x=x0; x!=x1; x++) { \
+      if (x!=x0 && !(x & 7)) \
+        b=reader8(src+x/8); \
+      acc=(acc<<ESPVGAX_BPP) | (((b<<(x & 7)) & 0x80) ? fg : bg); \
+      bits+=ESPVGAX_BPP; \
+      if (bits==8) { \
+        *r++=acc; \
+        acc=0; \
+        bits=0; \
+      } \
+    } \
+    if (bits) \
+      *r++=acc<<(8-bits); \
+    r[0]=r[1]=r[2]=r[3]=0; \
+    blit(row, dx+x0, dy+y, x1-x0, 1, op); \
+  }
+
+void ESPVGAX::blitMono_P(ESPVGAX_PROGMEM uint8_t *src, int dx, int dy, 
+  int srcw, int srch, uint8_t fg, uint8_t bg, int op, int srcwstride) {
+
+  BLITMONOMETHOD(pgm_read_byte, blit_P);
+}
+void ESPVGAX::blitMono(uint8_t *src, int dx, int dy, int srcw, int srch, 
+  uint8_t fg, uint8_t bg, int op, int srcwstride) {
+
+  BLITMONOMETHOD(*(uint8_t*), blit);
+}
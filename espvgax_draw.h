@@ -14,16 +14,17 @@ static inline void draw_row(int line, int x0, int x1, uint8_t c, int op) {
 	    x1=tmp;
 	  }
 	  int sw=x1-x0;
-    while (x0%32 && sw > 32) {
+    while (x0%ESPVGAX_WORD_PIXELS && sw > ESPVGAX_WORD_PIXELS) {
       ESPVGAX::putpixel(x0, line, c, op);
       x0++;
       sw--;
     }
-	  while (sw>32) {
-	  	uint32_t c32=c ? 0xffffffff : 0;
-  		ESPVGAX::putpixel32(x0/32, line, SWAP_UINT32(c32), op);
-	  	x0+=32;
-	  	sw-=32;
+	  // all the pixels of the word have the color c, in both byte orders
+	  uint32_t c32=ESPVGAX_PIXEL(c)*(0xffffffff/ESPVGAX_PIXEL_MASK);
+	  while (sw>ESPVGAX_WORD_PIXELS) {
+  		ESPVGAX::putpixel32(x0/ESPVGAX_WORD_PIXELS, line, c32, op);
+	  	x0+=ESPVGAX_WORD_PIXELS;
+	  	sw-=ESPVGAX_WORD_PIXELS;
 	  }
     while (sw>0) {
       ESPVGAX::putpixel(x0, line, c, op);
@@ -47,12 +48,178 @@ static inline void draw_column(int row, int y0, int y1, uint8_t c, int op) {
 	  }
 	}
 }
+/*
+ * masked (m) write of the words d, from the first word of the line to the 
+ * last one e, and full word writes between them
+ */
+#define FILLRECT(masked, full) \
+  for (; y!=y1; y++) { \
+    volatile uint32_t *d=&fbw[y][w0]; \
+    volatile uint32_t *e=&fbw[y][w1]; \
+    uint32_t m=head; \
+    masked; \
+    if (d!=e) { \
+      while (++d!=e) \
+        full; \
+      m=tail; \
+      masked; \
+    } \
+  }
+
+void ESPVGAX::fillRect(int x, int y, int w, int h, uint8_t c, int op) {
+  int x1=x+w, y1=y+h;
+  if (x<0)
+    x=0;
+  if (y<0)
+    y=0;
+  if (x1>ESPVGAX_WIDTH)
+    x1=ESPVGAX_WIDTH;
+  if (y1>ESPVGAX_HEIGHT)
+    y1=ESPVGAX_HEIGHT;
+  if (x>=x1 || y>=y1)
+    return;
+  ESPVGAX_MARK_DIRTY_RECT(x, y, x1-x, y1-y);
+  // first and last word, and their masks in pixel order
+  int b0=x*ESPVGAX_BPP, b1=x1*ESPVGAX_BPP;
+  int w0=b0>>5, w1=(b1-1)>>5;
+  uint32_t head=0xffffffff>>(b0 & 31);
+  uint32_t tail=0xffffffff<<(-b1 & 31);
+  if (w0==w1)
+    head&=tail;
+  head=ESPVGAX_PIXELS32(head);
+  tail=ESPVGAX_PIXELS32(tail);
+  // all the pixels of the word have the color c, in both byte orders
+  uint32_t c32=ESPVGAX_PIXEL(c)*(0xffffffff/ESPVGAX_PIXEL_MASK);
+  if (op==ESPVGAX_OP_OR) {
+    FILLRECT(*d|=c32 & m, *d|=c32);
+  } else if (op==ESPVGAX_OP_XOR) {
+    FILLRECT(*d^=c32 & m, *d^=c32);
+  } else {
+    FILLRECT(*d=(*d & ~m) | (c32 & m), *d=c32);
+  }
+}
+void ESPVGAX::invertRect(int x, int y, int w, int h) {
+  fillRect(x, y, w, h, ESPVGAX_PIXEL_MASK, ESPVGAX_OP_XOR);
+}
+// word q of the line l in pixel order, 0 outside the line
+static inline uint32_t scroll_word(volatile uint32_t *l, int q) {
+  return (uint32_t)q<ESPVGAX_WWIDTH ? ESPVGAX_PIXELS32(l[q]) : 0;
+}
+// funnel shift: 32 pixels from the bit s of the pixel ordered words a and n
+#define SCROLL_FUNNEL(a, n, s) \
+  ((uint32_t)(((uint64_t)(a)<<32 | (n))>>(32-(s))))
+// masked write of the pixel ordered word v, full words between w0 and w1
+#define SCROLL_WRITE(i, v) \
+  if (i==w0 || i==w1) { \
+    uint32_t m=i==w0 ? head : tail; \
+    d[i]=(d[i] & ~m) | (ESPVGAX_PIXELS32(v) & m); \
+  } else { \
+    d[i]=ESPVGAX_PIXELS32(v); \
+  }
+
+void ESPVGAX::scrollRect(int x, int y, int w, int h, int dx, int dy, 
+  uint8_t c) {
+  int x1=x+w, y1=y+h;
+  if (x<0)
+    x=0;
+  if (y<0)
+    y=0;
+  if (x1>ESPVGAX_WIDTH)
+    x1=ESPVGAX_WIDTH;
+  if (y1>ESPVGAX_HEIGHT)
+    y1=ESPVGAX_HEIGHT;
+  if (x>=x1 || y>=y1)
+    return;
+  w=x1-x;
+  h=y1-y;
+  if (dx<=-w || dx>=w || dy<=-h || dy>=h) {
+    fillRect(x, y, w, h, c);
+    return;
+  }
+  ESPVGAX_MARK_DIRTY_RECT(x, y, w, h);
+  // rows moved: destination rows from r0 to r1 (excluded), in steps of dr
+  int r0=dy>0 ? y1-1 : y, r1=dy>0 ? y+dy-1 : y1+dy, dr=dy>0 ? -1 : 1;
+  if (dx==0 && x==0 && x1==ESPVGAX_WIDTH) {
+    // full lines, a single memmove
+    if (dy>0)
+      memmove((void*)fbw[y+dy], (void*)fbw[y], (h-dy)*ESPVGAX_BWIDTH);
+    else if (dy<0)
+      memmove((void*)fbw[y], (void*)fbw[y-dy], (h+dy)*ESPVGAX_BWIDTH);
+  } else if (dx || dy) {
+    // first and last word, and their masks in pixel order, as fillRect
+    int b0=x*ESPVGAX_BPP, b1=x1*ESPVGAX_BPP;
+    int w0=b0>>5, w1=(b1-1)>>5;
+    uint32_t head=0xffffffff>>(b0 & 31);
+    uint32_t tail=0xffffffff<<(-b1 & 31);
+    if (w0==w1)
+      head&=tail;
+    head=ESPVGAX_PIXELS32(head);
+    tail=ESPVGAX_PIXELS32(tail);
+    /*
+     * the word i of the destination line is made of the words i+off and
+     * i+off+1 of the source line, from their bit sh. The words outside the
+     * line are read as 0, vacated pixels are filled after
+     */
+    int db=-dx*ESPVGAX_BPP;
+    int off=db>>5, sh=db & 31;
+    for (int r=r0; r!=r1; r+=dr) {
+      volatile uint32_t *d=fbw[r];
+      volatile uint32_t *s=fbw[r-dy];
+      /*
+       * on the same line the words are written in the direction of the 
+       * shift, so each word is read before it is written. The word read
+       * for the previous destination word is carried to the next one
+       */
+      if (dx<=0) {
+        uint32_t a=scroll_word(s, w0+off);
+        for (int i=w0; i<=w1; i++) {
+          uint32_t n=scroll_word(s, i+off+1);
+          SCROLL_WRITE(i, SCROLL_FUNNEL(a, n, sh));
+          a=n;
+        }
+      } else {
+        uint32_t n=scroll_word(s, w1+off+1);
+        for (int i=w1; i>=w0; i--) {
+          uint32_t a=scroll_word(s, i+off);
+          SCROLL_WRITE(i, SCROLL_FUNNEL(a, n, sh));
+          n=a;
+        }
+      }
+    }
+  }
+  // vacated space
+  if (dy>0)
+    fillRect(x, y, w, dy, c);
+  else if (dy<0)
+    fillRect(x, y1+dy, w, -dy, c);
+  if (dx>0)
+    fillRect(x, y, dx, h, c);
+  else if (dx<0)
+    fillRect(x1+dx, y, -dx, h, c);
+}
+void ESPVGAX::scrollUp(int n, uint8_t c) {
+  scrollRect(0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT, 0, -n, c);
+}
+void ESPVGAX::scrollDown(int n, uint8_t c) {
+  scrollRect(0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT, 0, n, c);
+}
+void ESPVGAX::scrollLeft(int n, uint8_t c) {
+  scrollRect(0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT, -n, 0, c);
+}
+void ESPVGAX::scrollRight(int n, uint8_t c) {
+  scrollRect(0, 0, ESPVGAX_WIDTH, ESPVGAX_HEIGHT, n, 0, c);
+}
 // porting of TVOut::draw_row method, writen by Myles Metzer
 void ESPVGAX::drawRect(int x0, int y0, int w, int h, uint8_t c, bool fill, int op) {
 	if (fill) {
-    for (int i=y0; i<y0+h; i++) {
-      draw_row(i, x0, x0+w, c, op);
+    // like draw_row: a negative w fills at the left of x0, w=0 one pixel
+    if (w<0) {
+      x0+=w;
+      w=-w;
+    } else if (w==0) {
+      w=1;
     }
+    fillRect(x0, y0, w, h, c, op);
   } else {
 	  drawLine(x0,   y0,   x0+w, y0,   c, op);
 	  drawLine(x0,   y0,   x0,   y0+h, c, op);
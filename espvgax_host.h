@@ -0,0 +1,602 @@
+/*
+ * ESPVGAX host backend. Included by ESPVGAX.h instead of the ESP8266 Arduino
+ * core when ESPVGAX_HOST is defined, so that the library (vga_handler
+ * included) can be built and run on a Linux PC.
+ *
+ * The backend emulates the small subset of the ESP8266 hardware used by the
+ * library:
+ *    - a mirror of the peripheral address space 0x60000000..0x60000FFF where
+ *      GPIO (GPO, GPOS, GPOC, GP16O), HSPI and IO_MUX registers live
+ *    - the CCOUNT cycle counter
+ *    - TIMER0 and TIMER1, used to call vga_handler at every VGA line
+ *    - the HSPI shift register: when SPI_USR is set SPI_USR_MOSI_BITLEN bits
+ *      of SPI_W0..SPI_W15 (or of SPI_W8..SPI_W15, SPI_USR_MOSI_HIGHPART) are
+ *      captured and the transfer stays busy for the time needed to shift 
+ *      them out at the programmed SPI clock, 4 bits for each clock with
+ *      SPI_FWRITE_QUAD and 2 with SPI_FWRITE_DUAL
+ *    - the HSPI transfer done interrupt (SPI_TRANS_DONE_EN of SPI_SLAVE), 
+ *      attached with ETS_SPI_INTR_ATTACH
+ *
+ * Simulated time only moves forward when the library reads CCOUNT from the
+ * main loop (ESPVGAX::delay) or when one of the ESPVGAXHost::run* methods is
+ * called. Each time the timer deadline is reached the installed interrupt
+ * handler is called, exactly like the hardware timer does.
+ *
+ * Inside the interrupt handler time is modeled with a simple cost table: the
+ * interrupt entry latency, CCOUNT reads of the busy waits, peripheral 
+ * register reads and writes and the copy of the line into the HSPI W 
+ * registers. The constants
+ * ESPVGAX_HOST_*_CYCLES below are estimates and can be redefined with -D to
+ * match measurements done on the real MCU. GPIO changes, HSPI transfers and
+ * interrupt entry/exit are recorded inside ESPVGAXHost::events, with their
+ * CCOUNT timestamp (see tools/host/vgasim.cpp).
+ *
+ * Example (build with g++ -std=c++17 -DESPVGAX_HOST -I. ESPVGAX.cpp main.cpp):
+ *
+ *    ESPVGAX::begin();
+ *    ESPVGAX::drawRect(10, 10, 100, 100, 1);
+ *    ESPVGAXHost::runFrames(1);
+ *    uint8_t *scanline=ESPVGAXHost::capture[10];
+ */
+#ifndef __ESPVGAX_HOST__
+#define __ESPVGAX_HOST__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+#ifndef F_CPU
+#define F_CPU 80000000L
+#endif
+#define APB_CLK_FREQ 80000000L
+
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define BIT(nr) (1UL<<(nr))
+
+typedef uint8_t uint8;
+
+// NodeMCU PIN names to GPIO numbers
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define OUTPUT 1
+#define INPUT 0
+
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define memcpy_P memcpy
+
+// TIMER1 dividers and modes, same values of the ESP8266 Arduino core
+#define TIM_DIV1 0
+#define TIM_DIV16 1
+#define TIM_DIV256 3
+#define TIM_EDGE 0
+#define TIM_LEVEL 1
+#define TIM_SINGLE 0
+#define TIM_LOOP 1
+
+// size of the emulated peripheral address space (0x60000000..0x60000FFF)
+#define ESPVGAX_HOST_PERI_SIZE 0x1000
+// number of captured HSPI transfers (more than one VGA frame)
+#define ESPVGAX_HOST_CAPTURE_LINES 1024
+// bytes captured for each VGA line, from one or more HSPI transfers
+#define ESPVGAX_HOST_CAPTURE_BYTES 512
+// maximum number of recorded events
+#define ESPVGAX_HOST_MAX_EVENTS 65536
+
+// cycles from the timer deadline to the first instruction of vga_handler
+#ifndef ESPVGAX_HOST_IRQ_CYCLES
+#define ESPVGAX_HOST_IRQ_CYCLES 60
+#endif
+// cycles from the end of vga_handler to the return to the main loop
+#ifndef ESPVGAX_HOST_IRET_CYCLES
+#define ESPVGAX_HOST_IRET_CYCLES 30
+#endif
+// cycles needed to read a peripheral register
+#ifndef ESPVGAX_HOST_REG_READ_CYCLES
+#define ESPVGAX_HOST_REG_READ_CYCLES 8
+#endif
+// cycles needed to write a peripheral register
+#ifndef ESPVGAX_HOST_REG_WRITE_CYCLES
+#define ESPVGAX_HOST_REG_WRITE_CYCLES 2
+#endif
+// cycles needed to copy a 32bit word from RAM to a peripheral register
+#ifndef ESPVGAX_HOST_COPY_WORD_CYCLES
+#define ESPVGAX_HOST_COPY_WORD_CYCLES 4
+#endif
+// cycles needed to rotate a 32bit word and store it in a peripheral register
+#ifndef ESPVGAX_HOST_SCROLL_WORD_CYCLES
+#define ESPVGAX_HOST_SCROLL_WORD_CYCLES 9
+#endif
+// cycles needed to compose a 32bit word of a text mode line from 4 glyphs
+#ifndef ESPVGAX_HOST_TEXT_WORD_CYCLES
+#define ESPVGAX_HOST_TEXT_WORD_CYCLES 16
+#endif
+// cycles needed to compose a 32bit word of a tile mode line, from 4 tiles
+#ifndef ESPVGAX_HOST_TILE_WORD_CYCLES
+#define ESPVGAX_HOST_TILE_WORD_CYCLES 28
+#endif
+// cycles needed to test a sprite and to draw it on a tile mode line
+#ifndef ESPVGAX_HOST_SPRITE_CYCLES
+#define ESPVGAX_HOST_SPRITE_CYCLES 40
+#endif
+// cycles needed to merge an overlay line into two words of a line copy
+#ifndef ESPVGAX_HOST_OVERLAY_CYCLES
+#define ESPVGAX_HOST_OVERLAY_CYCLES 30
+#endif
+
+// cycles of one iteration of a busy wait loop on a volatile variable
+#ifndef ESPVGAX_HOST_SPIN_CYCLES
+#define ESPVGAX_HOST_SPIN_CYCLES 4
+#endif
+
+// recorded events types
+#define ESPVGAX_HOST_EV_GPIO 1 // v is the new GPO value
+#define ESPVGAX_HOST_EV_GPIO16 2 // v is the new GP16O value
+#define ESPVGAX_HOST_EV_SPI 3 // HSPI transfer started, v is the end CCOUNT
+#define ESPVGAX_HOST_EV_IRQ 4 // interrupt handler called, v is the deadline
+#define ESPVGAX_HOST_EV_IRET 5 // interrupt handler returned
+#define ESPVGAX_HOST_EV_SPIIRQ 6 // SPI handler called, v is the transfer end
+#define ESPVGAX_HOST_EV_SPIIRET 7 // SPI handler returned
+
+class ESPVGAXHostEvent {
+public:
+  uint32_t t, v;
+  uint8_t type;
+};
+
+typedef void (*ESPVGAXHostISR)();
+typedef void (*ESPVGAXHostSPIISR)(void*);
+
+// ESPVGAXHost static class
+class ESPVGAXHost {
+public:
+  /*
+   * peri[ESPVGAX_HOST_PERI_SIZE]
+   *    memory that backs the emulated peripheral registers. Register
+   *    0x600000XX is stored at peri[0xXX]
+   */
+  static inline uint8_t peri[ESPVGAX_HOST_PERI_SIZE]
+    __attribute__ ((aligned(4)));
+  /*
+   * ccount
+   *    emulated CCOUNT register (CPU cycles at F_CPU)
+   */
+  static inline uint32_t ccount=0;
+  /*
+   * gpo, gp16o
+   *    current level of the GPIO0..15 outputs and of the GPIO16 output
+   */
+  static inline uint32_t gpo=0;
+  static inline uint32_t gp16o=0;
+  /*
+   * capture[ESPVGAX_HOST_CAPTURE_LINES][ESPVGAX_HOST_CAPTURE_BYTES]
+   * captured[ESPVGAX_HOST_CAPTURE_LINES]
+   *    bits shifted out by the HSPI for each timer interrupt, indexed by the
+   *    number of interrupts fired since the handler has been attached
+   *    (modulo ESPVGAX_HOST_CAPTURE_LINES). The transfers started by the 
+   *    same interrupt are appended. Lines where no HSPI transfer has been 
+   *    started are zeroed and have captured[n]==0, otherwise captured[n] is
+   *    the number of transfers. Bytes are stored in the order they are 
+   *    shifted out, following SPI_WR_BYTE_ORDER
+   */
+  static inline uint8_t capture[ESPVGAX_HOST_CAPTURE_LINES]
+    [ESPVGAX_HOST_CAPTURE_BYTES];
+  static inline uint8_t captured[ESPVGAX_HOST_CAPTURE_LINES];
+  // bytes appended to the capture of the current line
+  static inline uint32_t capturepos=0;
+  /*
+   * spioverlaps
+   *    number of HSPI transfers started while the previous one was still
+   *    running. The real HSPI ignores them
+   */
+  static inline uint32_t spioverlaps=0;
+  /*
+   * spistaged
+   *    number of lines copied to the HSPI W registers by the transfer done
+   *    interrupt (ESPVGAX_SPI_PIPELINE), instead of vga_handler
+   */
+  static inline uint32_t spistaged=0;
+  /*
+   * irqs
+   *    number of timer interrupts fired since the handler has been attached
+   */
+  static inline uint32_t irqs=0;
+  // interrupt handler installed by timer0/timer1_attachInterrupt
+  static inline ESPVGAXHostISR isr=0;
+  // 0 for TIMER0 (CCOUNT compare), 1 for TIMER1 (reload counter)
+  static inline int timer=1;
+  static inline uint32_t timer1div=16;
+  static inline uint32_t timer1load=0;
+  static inline bool timer1loop=true;
+  static inline uint32_t deadline=0;
+  static inline bool armed=false;
+  static inline bool irqenabled=true;
+  static inline bool inisr=false;
+  // CCOUNT value where the current HSPI transfer will end
+  static inline uint32_t spiend=0;
+  static inline bool spibusy=false;
+  // SPI interrupt handler installed by ETS_SPI_INTR_ATTACH
+  static inline ESPVGAXHostSPIISR spiisr=0;
+  static inline void *spiisrarg=0;
+  static inline bool spiintenabled=false;
+  /*
+   * events[ESPVGAX_HOST_MAX_EVENTS]
+   * eventscount
+   *    recorded events. Recording stops when the buffer is full, set 
+   *    eventscount to 0 to restart recording
+   */
+  static inline ESPVGAXHostEvent events[ESPVGAX_HOST_MAX_EVENTS];
+  static inline uint32_t eventscount=0;
+
+  static void record(uint8_t type, uint32_t v) {
+    if (eventscount==ESPVGAX_HOST_MAX_EVENTS)
+      return;
+    ESPVGAXHostEvent &e=events[eventscount++];
+    e.t=ccount;
+    e.type=type;
+    e.v=v;
+  }
+  /*
+   * cost(cycles)
+   *    charge the given number of CPU cycles to the running code
+   */
+  static void cost(uint32_t cycles) {
+    advance(cycles);
+  }
+
+  // translate a 0x600000XX register address to its host memory address
+  static inline uintptr_t addr(uint32_t reg) {
+    return (uintptr_t)peri+(reg & (ESPVGAX_HOST_PERI_SIZE-1));
+  }
+  // translate a host memory address to the 0x600000XX register offset
+  static inline uint32_t offset(uintptr_t a) {
+    return (uint32_t)(a-(uintptr_t)peri);
+  }
+  static inline uint32_t &raw(uint32_t off) {
+    return *(uint32_t*)(peri+off);
+  }
+  /*
+   * read(a)
+   * write(a, v)
+   *    access to an emulated register. a is the host address returned by
+   *    addr(). Writes to GPOS/GPOC/GP16O update gpo/gp16o, writes to SPI_CMD
+   *    of HSPI start the emulated transfer
+   */
+  static uint32_t read(uintptr_t a) {
+    uint32_t off=offset(a);
+    cost(ESPVGAX_HOST_REG_READ_CYCLES);
+    if (off==0x100 && spibusy && (int32_t)(ccount-spiend)>=0)
+      spiFinish();
+    switch (off) {
+    case 0x300:
+    case 0x304:
+    case 0x308:
+      return gpo;
+    case 0x768:
+      return gp16o;
+    }
+    return raw(off);
+  }
+  static void write(uintptr_t a, uint32_t v) {
+    uint32_t off=offset(a);
+    uint32_t prev=gpo;
+    cost(ESPVGAX_HOST_REG_WRITE_CYCLES);
+    switch (off) {
+    case 0x300:
+    case 0x304:
+    case 0x308:
+      if (off==0x300)
+        gpo=v;
+      else if (off==0x304)
+        gpo|=v;
+      else
+        gpo&=~v;
+      if (gpo!=prev)
+        record(ESPVGAX_HOST_EV_GPIO, gpo);
+      return;
+    case 0x768:
+      if (gp16o!=v)
+        record(ESPVGAX_HOST_EV_GPIO16, v);
+      gp16o=v;
+      return;
+    case 0x100:
+      if (spibusy && (int32_t)(ccount-spiend)>=0)
+        spiFinish();
+      if ((v & BIT(18)) && spibusy)
+        spioverlaps++;
+      else if (v & BIT(18))
+        spiStart();
+      break;
+    }
+    raw(off)=v;
+  }
+  /*
+   * spiClockCycles()
+   *    number of CPU cycles needed to shift out a single bit, from the HSPI
+   *    SPI_CLOCK register
+   */
+  static uint32_t spiClockCycles() {
+    uint32_t clk=raw(0x118);
+    uint32_t apb=1;
+    if (!(clk & BIT(31)))
+      apb=(((clk>>18) & 0x1fff)+1)*(((clk>>12) & 0x3f)+1);
+    return apb*(F_CPU/APB_CLK_FREQ);
+  }
+  /*
+   * spiClockBits()
+   *    number of bits shifted out for each SPI clock, from the HSPI SPI_USER
+   *    register (SPI_FWRITE_QUAD, SPI_FWRITE_DUAL)
+   */
+  static uint32_t spiClockBits() {
+    if (raw(0x11c) & BIT(13))
+      return 4;
+    return (raw(0x11c) & BIT(12)) ? 2 : 1;
+  }
+  // HSPI transfer is finished: clear SPI_USR, set SPI_TRANS_DONE
+  static void spiFinish() {
+    spibusy=false;
+    raw(0x100)&=~BIT(18);
+    raw(0x130)|=BIT(4);
+  }
+  /*
+   * spiIntStatus()
+   *    the SPI interrupt status register (SPIIS): bit 7 is set while the 
+   *    HSPI has an enabled interrupt pending
+   */
+  static uint32_t spiIntStatus() {
+    uint32_t slave=raw(0x130);
+    return (slave & (slave>>5) & 0x1f) ? BIT(7) : 0;
+  }
+  static void spiStart() {
+    uint32_t n=irqs ? irqs-1 : 0;
+    uint32_t bits=((raw(0x120)>>17) & 0x1ff)+1;
+    // SPI_USR_MOSI_HIGHPART: send from SPI_W8
+    uint32_t src=(raw(0x11c) & BIT(25)) ? 0x160 : 0x140;
+    uint32_t bytes=std::min((bits+31)/32*4, 0x180-src);
+    if (!captured[n % ESPVGAX_HOST_CAPTURE_LINES])
+      capturepos=0;
+    bytes=std::min<uint32_t>(bytes, ESPVGAX_HOST_CAPTURE_BYTES-capturepos);
+    uint8_t *dst=capture[n % ESPVGAX_HOST_CAPTURE_LINES]+capturepos;
+    memcpy(dst, peri+src, bytes);
+    if (raw(0x11c) & BIT(11)) {
+      // SPI_WR_BYTE_ORDER: W registers are sent from the most significant byte
+      for (uint32_t i=0; i+3<bytes; i+=4) {
+        std::swap(dst[i], dst[i+3]);
+        std::swap(dst[i+1], dst[i+2]);
+      }
+    }
+    capturepos+=bytes;
+    captured[n % ESPVGAX_HOST_CAPTURE_LINES]++;
+    spibusy=true;
+    spiend=ccount+(bits+spiClockBits()-1)/spiClockBits()*spiClockCycles();
+    record(ESPVGAX_HOST_EV_SPI, spiend);
+  }
+  /*
+   * timerPeriod()
+   *    CPU cycles between two TIMER1 interrupts
+   */
+  static uint32_t timerPeriod() {
+    return timer1load*timer1div*(F_CPU/APB_CLK_FREQ);
+  }
+  static void attach(int t, ESPVGAXHostISR fn) {
+    timer=t;
+    isr=fn;
+    irqs=0;
+    armed=false;
+    memset(captured, 0, sizeof(captured));
+  }
+  static void fire() {
+    uint32_t n=irqs % ESPVGAX_HOST_CAPTURE_LINES;
+    memset(capture[n], 0, ESPVGAX_HOST_CAPTURE_BYTES);
+    captured[n]=0;
+    irqs++;
+    uint32_t t=deadline;
+    if (timer==1 && timer1loop)
+      deadline+=timerPeriod();
+    else
+      armed=false;
+    // a late interrupt is called as soon as the previous one has returned
+    if ((int32_t)(t-ccount)>0)
+      ccount=t;
+    inisr=true;
+    ccount+=ESPVGAX_HOST_IRQ_CYCLES;
+    record(ESPVGAX_HOST_EV_IRQ, t);
+    isr();
+    record(ESPVGAX_HOST_EV_IRET, t);
+    ccount+=ESPVGAX_HOST_IRET_CYCLES;
+    inisr=false;
+  }
+  // call the SPI interrupt handler for the transfer ended at t
+  static void fireSPI(uint32_t t) {
+    if ((int32_t)(t-ccount)>0)
+      ccount=t;
+    if (spibusy && (int32_t)(ccount-spiend)>=0)
+      spiFinish();
+    inisr=true;
+    ccount+=ESPVGAX_HOST_IRQ_CYCLES;
+    record(ESPVGAX_HOST_EV_SPIIRQ, t);
+    spiisr(spiisrarg);
+    record(ESPVGAX_HOST_EV_SPIIRET, t);
+    ccount+=ESPVGAX_HOST_IRET_CYCLES;
+    inisr=false;
+  }
+  /*
+   * advance(cycles)
+   *    move simulated time forward. Every interrupt whose deadline is reached
+   *    is called, in time order, unless the code is already running inside 
+   *    an interrupt handler or interrupts are disabled. The SPI interrupt is
+   *    raised at the end of a transfer, and stays pending while 
+   *    SPI_TRANS_DONE is set
+   */
+  static void advance(uint32_t cycles) {
+    uint32_t target=ccount+cycles;
+    if (inisr || !irqenabled) {
+      ccount=target;
+      return;
+    }
+    for (;;) {
+      bool spi=false;
+      uint32_t spit=ccount;
+      if (spiisr && spiintenabled && (raw(0x130) & BIT(9))) {
+        if (raw(0x130) & BIT(4)) {
+          spi=true;
+        } else if (spibusy && (int32_t)(target-spiend)>=0) {
+          spi=true;
+          spit=spiend;
+        }
+      }
+      bool tim=isr && armed && (int32_t)(target-deadline)>=0;
+      if (!spi && !tim)
+        break;
+      if (spi && (!tim || (int32_t)(spit-deadline)<=0))
+        fireSPI(spit);
+      else
+        fire();
+      if ((int32_t)(ccount-target)>0)
+        target=ccount;
+    }
+    ccount=target;
+  }
+  /*
+   * runLines(n)
+   * runFrames(n, lines)
+   *    run the emulation until n timer interrupts have been fired. runFrames
+   *    runs n VGA frames of 525 lines
+   */
+  static void runLines(uint32_t n) {
+    while (n-- && isr && armed) {
+      if ((int32_t)(deadline-ccount)>0)
+        advance(deadline-ccount);
+      else
+        advance(0);
+    }
+  }
+  static void runFrames(uint32_t n, uint32_t lines=525) {
+    runLines(n*lines);
+  }
+  /*
+   * ticks()
+   *    read CCOUNT. Reading CCOUNT costs one cycle, so busy loops like 
+   *    ESPVGAX::delay end
+   */
+  static uint32_t ticks() {
+    advance(1);
+    return ccount;
+  }
+};
+
+// proxy returned by ESP8266_REG, used to intercept GPIO registers accesses
+struct ESPVGAXHostReg {
+  uint32_t off;
+  operator uint32_t() const {
+    return ESPVGAXHost::read(ESPVGAXHost::addr(off)); }
+  ESPVGAXHostReg &operator=(uint32_t v) {
+    ESPVGAXHost::write(ESPVGAXHost::addr(off), v); return *this; }
+  ESPVGAXHostReg &operator|=(uint32_t v) {
+    return *this=(uint32_t)*this | v; }
+  ESPVGAXHostReg &operator&=(uint32_t v) {
+    return *this=(uint32_t)*this & v; }
+};
+#define ESP8266_REG(addr) (ESPVGAXHostReg{(uint32_t)(addr)})
+#define GPO ESP8266_REG(0x300)
+#define GPOS ESP8266_REG(0x304)
+#define GPOC ESP8266_REG(0x308)
+#define GP16O ESP8266_REG(0x768)
+
+#define READ_PERI_REG(addr) ESPVGAXHost::read((uintptr_t)(addr))
+#define WRITE_PERI_REG(addr, val) \
+  ESPVGAXHost::write((uintptr_t)(addr), (uint32_t)(val))
+#define SET_PERI_REG_MASK(reg, mask) \
+  WRITE_PERI_REG((reg), (READ_PERI_REG(reg)|(mask)))
+#define CLEAR_PERI_REG_MASK(reg, mask) \
+  WRITE_PERI_REG((reg), (READ_PERI_REG(reg)&(~(mask))))
+
+#define PERIPHS_IO_MUX ESPVGAXHost::addr(0x800)
+#define PERIPHS_IO_MUX_MTDI_U ESPVGAXHost::addr(0x804)
+#define PERIPHS_IO_MUX_MTCK_U ESPVGAXHost::addr(0x808)
+#define PERIPHS_IO_MUX_MTMS_U ESPVGAXHost::addr(0x80C)
+#define PERIPHS_IO_MUX_MTDO_U ESPVGAXHost::addr(0x810)
+#define PERIPHS_IO_MUX_SD_DATA2_U ESPVGAXHost::addr(0x828)
+#define PERIPHS_IO_MUX_SD_DATA3_U ESPVGAXHost::addr(0x82C)
+#define PIN_FUNC_SELECT(pin, func) WRITE_PERI_REG((pin), (func))
+
+// cost of n unrolled word stores to the HSPI W registers
+#define ESPVGAX_HOST_STORE(n) \
+  ESPVGAXHost::cost((n)*ESPVGAX_HOST_COPY_WORD_CYCLES)
+// cost of the rotated copy of n words to the HSPI W registers
+#define ESPVGAX_HOST_SCROLL(n) \
+  ESPVGAXHost::cost((n)*ESPVGAX_HOST_SCROLL_WORD_CYCLES)
+// cost of the composition of n words of a text mode line
+#define ESPVGAX_HOST_TEXT(n) \
+  ESPVGAXHost::cost((n)*ESPVGAX_HOST_TEXT_WORD_CYCLES)
+// cost of the composition of n words of a tile mode line
+#define ESPVGAX_HOST_TILES(n) \
+  ESPVGAXHost::cost((n)*ESPVGAX_HOST_TILE_WORD_CYCLES)
+// cost of the sprites of a tile mode line, n sprites tested
+#define ESPVGAX_HOST_SPRITES(n) \
+  ESPVGAXHost::cost((n)*ESPVGAX_HOST_SPRITE_CYCLES)
+// cost of a line copy of words words, with n overlays merged into it
+#define ESPVGAX_HOST_OVERLAY(words, n) \
+  ESPVGAXHost::cost((words)*ESPVGAX_HOST_COPY_WORD_CYCLES+ \
+    (n)*ESPVGAX_HOST_OVERLAY_CYCLES)
+// a line copied by the HSPI transfer done interrupt
+#define ESPVGAX_HOST_STAGED() (ESPVGAXHost::spistaged++)
+// cost of one iteration of a busy wait loop. Let the interrupts run
+#define ESPVGAX_HOST_SPIN() ESPVGAXHost::advance(ESPVGAX_HOST_SPIN_CYCLES)
+
+static inline void pinMode(uint8_t, uint8_t) {}
+static inline void noInterrupts() { ESPVGAXHost::irqenabled=false; }
+static inline void interrupts() { ESPVGAXHost::irqenabled=true; }
+
+static inline void timer0_isr_init() {}
+static inline void timer0_attachInterrupt(ESPVGAXHostISR fn) {
+  ESPVGAXHost::attach(0, fn); }
+static inline void timer0_detachInterrupt() { ESPVGAXHost::isr=0; }
+static inline void timer0_write(uint32_t count) {
+  ESPVGAXHost::deadline=count;
+  ESPVGAXHost::armed=true;
+}
+static inline void timer1_isr_init() {}
+static inline void timer1_attachInterrupt(ESPVGAXHostISR fn) {
+  ESPVGAXHost::attach(1, fn); }
+static inline void timer1_detachInterrupt() { ESPVGAXHost::isr=0; }
+static inline void timer1_enable(uint8_t div, uint8_t, uint8_t reload) {
+  ESPVGAXHost::timer1div=div==TIM_DIV1 ? 1 : (div==TIM_DIV16 ? 16 : 256);
+  ESPVGAXHost::timer1loop=reload==TIM_LOOP;
+}
+static inline void timer1_write(uint32_t ticks) {
+  ESPVGAXHost::timer1load=ticks;
+  // a TIM_SINGLE timer starts counting from the write
+  if (!ESPVGAXHost::armed || !ESPVGAXHost::timer1loop) {
+    ESPVGAXHost::deadline=ESPVGAXHost::ccount+ESPVGAXHost::timerPeriod();
+    ESPVGAXHost::armed=true;
+  }
+}
+
+// SPI interrupt, shared by SPI (flash) and HSPI
+#define SPIIS (ESPVGAXHost::spiIntStatus())
+#define SPII0 4
+#define SPII1 7
+#define ETS_SPI_INTR_ATTACH(fn, arg) \
+  (ESPVGAXHost::spiisr=(ESPVGAXHostSPIISR)(fn), ESPVGAXHost::spiisrarg=(arg))
+#define ETS_SPI_INTR_ENABLE() (ESPVGAXHost::spiintenabled=true)
+#define ETS_SPI_INTR_DISABLE() (ESPVGAXHost::spiintenabled=false)
+
+class EspClass {
+public:
+  void wdtFeed() {}
+};
+inline EspClass ESP;
+
+#endif
@@ -3,7 +3,11 @@
 #define SPI 0
 #define HSPI 1
 
+#ifdef ESPVGAX_HOST
+#define REG_SPI_BASE(i)  ESPVGAXHost::addr(0x200-(i)*0x100)
+#else
 #define REG_SPI_BASE(i)  (0x60000200-i*0x100)
+#endif
 #define SPI_CMD(i) (REG_SPI_BASE(i) + 0x0)
 #define SPI_USR (BIT(18))
 
@@ -177,8 +181,100 @@
 #define SPI_INT_HOLD_ENA 0x00000003
 #define SPI_INT_HOLD_ENA_S 0
 
-#define HSPI_CLOCK_DIV 4
+/*
+ * 80MHz/HSPI_CLOCK_DIV pixel clock, one SPI clock for each pixel also with
+ * ESPVGAX_BPP 2 and 4. A line of 256 or 512 pixels lasts 25.6us, a line of 640 
+ * pixels 24us and a line of 800 pixels 20us
+ */
+#if ESPVGAX_LINE_WIDTH==640
+#define HSPI_CLOCK_DIV 3
+#elif ESPVGAX_LINE_WIDTH==800
+#define HSPI_CLOCK_DIV 2
+#else
+#define HSPI_CLOCK_DIV (2048/ESPVGAX_LINE_WIDTH)
+#endif
+// CPU cycles needed to send n pixels
+#define HSPI_PIXELS_CYCLES(n) ((n)*HSPI_CLOCK_DIV*(F_CPU/APB_CLK_FREQ))
+/*
+ * CPU cycles from the end of the busy wait of vga_handler to the first pixel
+ * sent, the SPI_CMD write (see tools/host/vgasim)
+ */
+#define HSPI_START_CYCLES 3
+// SPI_USER1 value of a transfer of n bits from the W registers
+#define HSPI_USER1(n) \
+  (((0 - 1) & SPI_USR_ADDR_BITLEN   ) << SPI_USR_ADDR_BITLEN_S | \
+   (((n) - 1) & SPI_USR_MOSI_BITLEN ) << SPI_USR_MOSI_BITLEN_S | \
+   ((0 - 1) & SPI_USR_DUMMY_CYCLELEN) << SPI_USR_DUMMY_CYCLELEN_S | \
+   ((0 - 1) & SPI_USR_MISO_BITLEN   ) << SPI_USR_MISO_BITLEN_S)
+
+#if ESPVGAX_LINE_WWIDTH>16
+/*
+ * wide modes: a line does not fit the 16 W registers (SPI_USR_MOSI_BITLEN is
+ * at most 511), so it is sent in chunks of 256 bits (256 pixels, 128 with 
+ * ESPVGAX_BPP 2, 64 with ESPVGAX_BPP 4), alternating W0..W7 
+ * and W8..W15 (SPI_USR_MOSI_HIGHPART). While a chunk is shifted out, the 
+ * next one is written to the other half. Each chunk begins when the previous
+ * one is finished: the seam is a short gap, at the same position of every
+ * line
+ */
+#define HSPI_WIDE
+#define HSPI_CHUNKS ((ESPVGAX_LINE_WWIDTH+7)/8)
+#define HSPI_CHUNK_PIXELS (256/ESPVGAX_BPP)
+#define HSPI_LAST_CHUNK_BITS ((ESPVGAX_LINE_WWIDTH-(HSPI_CHUNKS-1)*8)*32)
+#define HSPI_FIRST_CHUNK_BITS 256
+/*
+ * CPU cycles of a seam: HSPI_VGA_send polls SPI_CMD and starts the next chunk
+ * about 12 cycles after the end of the previous one (see tools/host/vgasim)
+ */
+#define HSPI_SEAM_CYCLES (12+ESPVGAX_SEAM_CYCLES)
+#define HSPI_LINE_CYCLES (HSPI_PIXELS_CYCLES(ESPVGAX_LINE_WIDTH)+ \
+  (HSPI_CHUNKS-1)*HSPI_SEAM_CYCLES)
+#ifdef ESPVGAX_HSCROLL
+#error "ESPVGAX_HSCROLL is not available with the wide modes"
+#endif
+// SPI_USER value set by HSPI_VGA_init, without SPI_USR_MOSI_HIGHPART
+static uint32_t hspiuser;
+#else
+#define HSPI_FIRST_CHUNK_BITS (ESPVGAX_LINE_WWIDTH*32)
+#define HSPI_LINE_CYCLES HSPI_PIXELS_CYCLES(ESPVGAX_LINE_WIDTH)
+#endif
 
+static void ICACHE_RAM_ATTR HSPI_wait() {
+  while (READ_PERI_REG(SPI_CMD(HSPI)) & SPI_USR);  
+}
+// write the W registers of a line with the 32 pixels fill, like a fbw word
+static void ICACHE_RAM_ATTR HSPI_VGA_fill(uint32_t fill) {
+  volatile uint32_t *w=(volatile uint32_t*)SPI_W0(HSPI);
+#ifdef ESPVGAX_HSCROLL
+  fill=ESPVGAX_PIXELS32(fill);
+#endif
+  HSPI_wait();
+  for (int i=0; i!=HSPI_FIRST_CHUNK_BITS/32; i++)
+    w[i]=fill;
+  ESPVGAX_HOST_STORE(HSPI_FIRST_CHUNK_BITS/32);
+}
+#ifndef ESPVGAX_HSCROLL
+/*
+ * copy the line to the HSPI W registers. A full 512 pixels line is copied 
+ * with 16 loads and 16 stores, without the memcpy call and loop overhead.
+ * The wide modes copy here the first two chunks, HSPI_VGA_send the others
+ */
+static void ICACHE_RAM_ATTR HSPI_VGA_prepare() {
+  volatile uint32_t *w=(volatile uint32_t*)SPI_W0(HSPI)+ESPVGAX_WINDOW_LEFT32;
+  volatile uint32_t *l=line;
+  HSPI_wait();
+#if ESPVGAX_WWIDTH>=16
+  w[0]=l[0]; w[1]=l[1]; w[2]=l[2]; w[3]=l[3];
+  w[4]=l[4]; w[5]=l[5]; w[6]=l[6]; w[7]=l[7];
+  w[8]=l[8]; w[9]=l[9]; w[10]=l[10]; w[11]=l[11];
+  w[12]=l[12]; w[13]=l[13]; w[14]=l[14]; w[15]=l[15];
+#else
+  for (int i=0; i!=ESPVGAX_WWIDTH; i++)
+    w[i]=l[i];
+#endif
+  ESPVGAX_HOST_STORE(ESPVGAX_WWIDTH);
+}
+#endif
 static inline void HSPI_VGA_init() {
   SET_PERI_REG_MASK(SPI_USER(HSPI), 
     /*SPI_CS_SETUP|SPI_CS_HOLD|*/SPI_WR_BYTE_ORDER);
@@ -190,8 +286,6 @@ static inline void HSPI_VGA_init() {
   CLEAR_PERI_REG_MASK(SPI_CTRL(HSPI), 
     SPI_QIO_MODE|SPI_DIO_MODE|SPI_DOUT_MODE|SPI_QOUT_MODE);
 
-  //WRITE_PERI_REG(SPI_CTRL(HSPI), SPI_QOUT_MODE);
-
   if (HSPI_CLOCK_DIV > 1) {
     uint8 i, k;
     i = (HSPI_CLOCK_DIV / 40) ? (HSPI_CLOCK_DIV / 40) : 1;
@@ -211,30 +305,176 @@ static inline void HSPI_VGA_init() {
   PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTCK_U, 2);
   PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTMS_U, 2);
   PIN_FUNC_SELECT(PERIPHS_IO_MUX_MTDO_U, 2);
-
+#if ESPVGAX_BPP==4
+  // HSPIHD and HSPIWP, the 2 more data pins of the quad output
+  PIN_FUNC_SELECT(PERIPHS_IO_MUX_SD_DATA2_U, 4);
+  PIN_FUNC_SELECT(PERIPHS_IO_MUX_SD_DATA3_U, 4);
+#endif
+
+#if defined(ESPVGAX_HSCROLL) || defined(ESPVGAX_NATIVE_ORDER)
+  /*
+   * send W registers from the most significant byte, see HSPI_VGA_scroll and
+   * ESPVGAX_NATIVE_ORDER
+   */
+  SET_PERI_REG_MASK(SPI_USER(HSPI), SPI_WR_BYTE_ORDER);
+#else
   // set HSPI bit order = LSB 
   CLEAR_PERI_REG_MASK(SPI_USER(HSPI), SPI_WR_BYTE_ORDER);
+#endif
+  /*
+   * the transfer is always the same: a line of ESPVGAX_LINE_WWIDTH words sent
+   * from the W registers (MOSI only). Configure it once, so HSPI_VGA_send
+   * has only to start it
+   */
+  CLEAR_PERI_REG_MASK(SPI_USER(HSPI), 
+    SPI_FLASH_MODE|SPI_USR_COMMAND|SPI_USR_ADDR|SPI_USR_MOSI|SPI_USR_DUMMY|SPI_USR_MISO|SPI_DOUTDIN|
+    SPI_USR_MOSI_HIGHPART|SPI_FWRITE_QIO|SPI_FWRITE_DIO|SPI_FWRITE_QUAD|
+    SPI_FWRITE_DUAL);
+  WRITE_PERI_REG(SPI_USER1(HSPI), HSPI_USER1(HSPI_FIRST_CHUNK_BITS));
+  /*
+   * quad/dual output of the MOSI data: 4/2 bits for each SPI clock. 
+   * SPI_QOUT_MODE and SPI_DOUT_MODE of SPI_CTRL select it only for the flash
+   * read commands
+   */
+#if ESPVGAX_BPP==4
+  SET_PERI_REG_MASK(SPI_USER(HSPI), SPI_FWRITE_QUAD);
+#elif ESPVGAX_BPP==2
+  SET_PERI_REG_MASK(SPI_USER(HSPI), SPI_FWRITE_DUAL);
+#endif
+  SET_PERI_REG_MASK(SPI_USER(HSPI), SPI_USR_MOSI);
+#ifdef HSPI_WIDE
+  hspiuser=READ_PERI_REG(SPI_USER(HSPI));
+#endif
+  /*
+   * W registers outside of the framebuffer window are written only here and
+   * at the end of the vertical blank, HSPI_VGA_prepare changes only the 
+   * window columns
+   */
+  HSPI_VGA_fill(ESPVGAX_WINDOW_FILL);
 }
-static void ICACHE_RAM_ATTR HSPI_wait() {
-  while (READ_PERI_REG(SPI_CMD(HSPI)) & SPI_USR);  
-}
-static void ICACHE_RAM_ATTR HSPI_VGA_prepare() {
+#ifdef ESPVGAX_HSCROLL
+/*
+ * copy the line to the HSPI W registers rotated left by offset pixels. The W
+ * registers are sent from the most significant byte (SPI_WR_BYTE_ORDER), so
+ * each framebuffer word is swapped only once (never with 
+ * ESPVGAX_NATIVE_ORDER), then two consecutive words are
+ * joined with a funnel shift (SRC instruction on Xtensa)
+ */
+static void ICACHE_RAM_ATTR HSPI_VGA_scroll(uint32_t offset) {
+  volatile uint32_t *w=(volatile uint32_t*)SPI_W0(HSPI)+ESPVGAX_WINDOW_LEFT32;
+  // rotate by bits
+  offset*=ESPVGAX_BPP;
+  uint32_t q=offset>>5;
   HSPI_wait();
-  memcpy((void*)SPI_W0(HSPI), (void*)line, ESPVGAX_BWIDTH);
+  uint32_t r=offset & 31;
+  uint32_t a=line[q];
+  a=ESPVGAX_PIXELS32(a);
+  for (int i=0; i!=ESPVGAX_WWIDTH; i++) {
+    if (++q==ESPVGAX_WWIDTH)
+      q=0;
+    uint32_t b=line[q];
+    b=ESPVGAX_PIXELS32(b);
+    w[i]=(uint32_t)((((uint64_t)a<<32) | b)>>(32-r));
+    a=b;
+  }
+  ESPVGAX_HOST_SCROLL(ESPVGAX_WWIDTH);
+}
+#endif
+/*
+ * restore the first chunk settings of the wide modes, changed by the previous
+ * line. Called before the pixeldata begins, while the HSPI is idle, so the 
+ * transfer starts with a single register write
+ */
+static inline void ICACHE_RAM_ATTR HSPI_VGA_first() {
+#ifdef HSPI_WIDE
+  WRITE_PERI_REG(SPI_USER1(HSPI), HSPI_USER1(HSPI_FIRST_CHUNK_BITS));
+  WRITE_PERI_REG(SPI_USER(HSPI), hspiuser);
+#endif
+}
+/*
+ * start the transfer configured by HSPI_VGA_init, the whole line or the first
+ * chunk of the wide modes. The other SPI_CMD bits are used only by the flash
+ * commands, so SPI_CMD is written without reading it
+ */
+static void ICACHE_RAM_ATTR HSPI_VGA_start() {
+  WRITE_PERI_REG(SPI_CMD(HSPI), SPI_USR);
 }
+#ifdef ESPVGAX_SPI_PIPELINE
+/*
+ * CPU cycles of HSPI_VGA_done with the interrupt entry and exit. It must end
+ * before the timer interrupt of the next line, or it would delay vga_handler
+ */
+#define HSPI_PIPELINE_CYCLES 240
+// set by HSPI_VGA_done when the next line is already in the W registers
+static volatile bool hspistaged;
+/*
+ * HSPI transfer done interrupt: copy the next line to the W registers as soon
+ * as the previous one has been shifted out, between the end of the 
+ * pixeldata and the next HSYNC pulse. The first line of the frame is copied
+ * by vga_handler, there is no transfer before it
+ */
+static void ICACHE_RAM_ATTR HSPI_VGA_done(void*) {
+  uint32_t is=SPIIS;
+  // the SPI interrupt is shared with the flash SPI
+  if (is & (1<<SPII0))
+    CLEAR_PERI_REG_MASK(SPI_SLAVE(SPI), 0x1f);
+  if (!(is & (1<<SPII1)))
+    return;
+  CLEAR_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_TRANS_DONE);
+  if (running && fby<vactive && !hspistaged) {
+    HSPI_VGA_prepare();
+    hspistaged=true;
+    ESPVGAX_HOST_STAGED();
+  }
+}
+/*
+ * copy the line during HSYNC, if HSPI_VGA_done has not done it. A transfer
+ * ended after the timer interrupt has been raised leaves SPI_TRANS_DONE set:
+ * clear it, or HSPI_VGA_done would overwrite the line while it is sent
+ */
+static inline void ICACHE_RAM_ATTR HSPI_VGA_stage() {
+  if (!hspistaged)
+    HSPI_VGA_prepare();
+  hspistaged=false;
+  CLEAR_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_TRANS_DONE);
+}
+static inline void HSPI_VGA_pipeline(bool enable) {
+  ETS_SPI_INTR_DISABLE();
+  CLEAR_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_TRANS_DONE|SPI_TRANS_DONE_EN);
+  hspistaged=false;
+  if (enable) {
+    ETS_SPI_INTR_ATTACH(HSPI_VGA_done, 0);
+    SET_PERI_REG_MASK(SPI_SLAVE(HSPI), SPI_TRANS_DONE_EN);
+    ETS_SPI_INTR_ENABLE();
+  }
+}
+#endif
+// send the line copied by HSPI_VGA_prepare
 static void ICACHE_RAM_ATTR HSPI_VGA_send() {
-  #define L (ESPVGAX_WIDTH)
-
-  CLEAR_PERI_REG_MASK(SPI_USER(HSPI), 
-    SPI_FLASH_MODE|SPI_USR_COMMAND|SPI_USR_ADDR|SPI_USR_MOSI|SPI_USR_DUMMY|SPI_USR_MISO|SPI_DOUTDIN);
-
-  WRITE_PERI_REG(SPI_USER1(HSPI),
-           ((0 - 1) & SPI_USR_ADDR_BITLEN   ) << SPI_USR_ADDR_BITLEN_S |
-           ((L - 1) & SPI_USR_MOSI_BITLEN   ) << SPI_USR_MOSI_BITLEN_S |
-           ((0 - 1) & SPI_USR_DUMMY_CYCLELEN) << SPI_USR_DUMMY_CYCLELEN_S |
-           ((0 - 1) & SPI_USR_MISO_BITLEN   ) << SPI_USR_MISO_BITLEN_S);
-
-  SET_PERI_REG_MASK(SPI_USER(HSPI), SPI_USR_MOSI);
-  SET_PERI_REG_MASK(SPI_CMD(HSPI), SPI_USR);
-  #undef L
+  HSPI_VGA_start();
+#ifdef HSPI_WIDE
+  uint32_t t=TICKS;
+  volatile uint32_t *w=(volatile uint32_t*)SPI_W0(HSPI);
+  volatile uint32_t *l=line;
+  for (int c=1; c!=HSPI_CHUNKS; c++) {
+    // wait for the end of the previous chunk, then start the chunk c
+    while (TICKS-t<HSPI_PIXELS_CYCLES(HSPI_CHUNK_PIXELS)+ESPVGAX_SEAM_CYCLES);
+    HSPI_wait();
+    if (c==HSPI_CHUNKS-1 && HSPI_LAST_CHUNK_BITS!=256)
+      WRITE_PERI_REG(SPI_USER1(HSPI), HSPI_USER1(HSPI_LAST_CHUNK_BITS));
+    WRITE_PERI_REG(SPI_USER(HSPI), 
+      hspiuser | ((c & 1) ? SPI_USR_MOSI_HIGHPART : 0));
+    t=TICKS;
+    WRITE_PERI_REG(SPI_CMD(HSPI), SPI_USR);
+    // write the chunk c+1 in the half of the W registers already sent
+    if (c+1<HSPI_CHUNKS) {
+      int n=ESPVGAX_LINE_WWIDTH-(c+1)*8;
+      if (n>8)
+        n=8;
+      for (int i=0; i!=n; i++)
+        w[((c+1) & 1)*8+i]=l[(c+1)*8+i];
+      ESPVGAX_HOST_STORE(n);
+    }
+  }
+#endif
 }
@@ -0,0 +1,127 @@
+//file included from ESPVGAX.cpp
+
+#ifdef ESPVGAX_OVERLAYS
+
+struct Overlay {
+  const uint32_t *bitmap;
+  const uint32_t *mask;
+  int16_t x, y;
+  uint8_t height;
+  uint8_t op;
+  bool visible;
+};
+static Overlay overlays[ESPVGAX_OVERLAYS];
+/*
+ * copies of the lines with the overlays, alternated so the line sent by the
+ * HSPI is never written
+ */
+static volatile uint32_t ESPVGAX_ALIGN32 overlaylines[2][ESPVGAX_WWIDTH];
+static int overlayslot;
+
+// merge the pixel ordered word v with the mask m into the fbw word l
+static inline uint32_t ICACHE_RAM_ATTR overlay_merge(uint32_t l, uint32_t v,
+  uint32_t m, int op) {
+  uint32_t p=ESPVGAX_PIXELS32(l);
+  if (op==ESPVGAX_OP_OR)
+    p|=v;
+  else if (op==ESPVGAX_OP_XOR)
+    p^=v;
+  else
+    p=(p & ~m) | (v & m);
+  return ESPVGAX_PIXELS32(p);
+}
+/*
+ * merge the overlays of the screen row in a copy of the line l, that is the
+ * framebuffer row rotated left by scroll pixels. Returns l if there are no
+ * overlays on the row. Each overlay line covers two fbw words
+ */
+static volatile uint32_t* ICACHE_RAM_ATTR overlay_line(volatile uint32_t *l,
+  int row, uint32_t scroll) {
+  volatile uint32_t *o=0;
+  int merged=0;
+  for (int i=0; i!=ESPVGAX_OVERLAYS; i++) {
+    const Overlay &ov=overlays[i];
+    uint32_t oy=row-ov.y;
+    if (!ov.visible || oy>=ov.height)
+      continue;
+    // clip the overlay pixels outside of the screen
+    int x=ov.x;
+    uint32_t c=0xffffffff;
+    if (x<0) {
+      if (x<=-ESPVGAX_WORD_PIXELS)
+        continue;
+      c>>=-x*ESPVGAX_BPP;
+    }
+    int right=x+ESPVGAX_WORD_PIXELS-ESPVGAX_WIDTH;
+    if (right>0) {
+      if (right>=ESPVGAX_WORD_PIXELS)
+        continue;
+      c&=0xffffffff<<(right*ESPVGAX_BPP);
+    }
+    if (!o) {
+      overlayslot^=1;
+      o=overlaylines[overlayslot];
+      for (int j=0; j!=ESPVGAX_WWIDTH; j++)
+        o[j]=l[j];
+    }
+    uint32_t v=ov.bitmap[oy] & c;
+    uint32_t m=(ov.mask ? ov.mask[oy] : 0xffffffff) & c;
+    // first bit of the overlay in the line, the words wrap around the row
+    x+=scroll;
+    if (x<0)
+      x+=ESPVGAX_WIDTH;
+    else if (x>=ESPVGAX_WIDTH)
+      x-=ESPVGAX_WIDTH;
+    int b=x*ESPVGAX_BPP;
+    int q=b>>5;
+    int s=b & 31;
+    o[q]=overlay_merge(o[q], v>>s, m>>s, ov.op);
+    if (s) {
+      q=q+1<ESPVGAX_WWIDTH ? q+1 : 0;
+      o[q]=overlay_merge(o[q], v<<(32-s), m<<(32-s), ov.op);
+    }
+    merged++;
+  }
+  ESPVGAX_HOST_OVERLAY(o ? ESPVGAX_WWIDTH : 0, merged);
+  return o ? o : l;
+}
+#endif
+
+void ESPVGAX::setOverlay(int n, const uint32_t *bitmap, int height,
+  const uint32_t *mask, int op) {
+#ifdef ESPVGAX_OVERLAYS
+  if (n<0 || n>=ESPVGAX_OVERLAYS || height<0 || height>255)
+    return;
+  noInterrupts();
+  overlays[n].bitmap=bitmap;
+  overlays[n].mask=mask;
+  overlays[n].height=bitmap ? height : 0;
+  overlays[n].op=op;
+  overlays[n].visible=false;
+  interrupts();
+#else
+  (void)n; (void)bitmap; (void)height; (void)mask; (void)op;
+#endif
+}
+void ESPVGAX::moveOverlay(int n, int x, int y) {
+#ifdef ESPVGAX_OVERLAYS
+  if (n<0 || n>=ESPVGAX_OVERLAYS)
+    return;
+  noInterrupts();
+  overlays[n].x=x;
+  overlays[n].y=y;
+  overlays[n].visible=true;
+  interrupts();
+#else
+  (void)n; (void)x; (void)y;
+#endif
+}
+void ESPVGAX::hideOverlay(int n) {
+#ifdef ESPVGAX_OVERLAYS
+  if (n<0 || n>=ESPVGAX_OVERLAYS)
+    return;
+  overlays[n].visible=false;
+#else
+  (void)n;
+#endif
+}
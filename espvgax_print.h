@@ -7,6 +7,8 @@ static uint8_t hspace;
 static uint8_t vspace;
 static uint8_t fntglyphw;
 static bool bmpfont;
+static uint8_t fntfg=ESPVGAX_PIXEL_MASK;
+static uint8_t fntbg;
 
 void ESPVGAX::setFont(ESPVGAX_PROGMEM uint8_t *fnt_, uint8_t glyphscount_, 
   uint8_t fntheight_, uint8_t fntglyphw_, uint8_t hspace_, uint8_t vspace_) {
@@ -19,6 +21,10 @@ void ESPVGAX::setFont(ESPVGAX_PROGMEM uint8_t *fnt_, uint8_t glyphscount_,
   vspace=vspace_;
   fntglyphw=fntglyphw_;
 }
+void ESPVGAX::setFontColor(uint8_t fg, uint8_t bg) {
+  fntfg=fg;
+  fntbg=bg;
+}
 void ESPVGAX::setBitmapFont(ESPVGAX_PROGMEM uint8_t *bmp, uint8_t h, int gw) {
   fnt=bmp;
   glyphscount=256;
@@ -43,10 +49,11 @@ void ESPVGAX::setBitmapFont(ESPVGAX_PROGMEM uint8_t *bmp, uint8_t h, int gw) {
       int bx=(uc%16); \
       int by=fntheight*(uc/16); \
       if (!calc) \
-        blit_P(fnt+(by*16+bx)*fntglyphw, \
+        blitMono_P(fnt+(by*16+bx)*fntglyphw, \
                 dx, dy0, \
                 8*fntglyphw, \
                 fntheight, \
+                fntfg, fntbg, \
                 op, \
                 128*fntglyphw); \
       dx+=8*fntglyphw; \
@@ -62,13 +69,15 @@ void ESPVGAX::setBitmapFont(ESPVGAX_PROGMEM uint8_t *bmp, uint8_t h, int gw) {
           dy0+=fntheight+vspace; \
         } \
         if (!calc) \
-          blit_P(fntg+4, dx, dy0, fntw, fntheight, op, fntglyphw*8); \
+          blitMono_P(fntg+4, dx, dy0, fntw, fntheight, fntfg, fntbg, op, \
+            fntglyphw*8); \
         if (bold) { \
           if (!calc) \
-            blit_P(fntg+4, \
+            blitMono_P(fntg+4, \
                     dx+1, dy0, \
                     fntw, \
                     fntheight, \
+                    fntfg, fntbg, \
                     ESPVGAX_OP_OR, \
                     fntglyphw*8); \
           dx++; \
@@ -0,0 +1,98 @@
+//file included from ESPVGAX.cpp
+
+#ifdef ESPVGAX_STATS
+
+static ESPVGAX::Stats stats;
+// incremented before and after each update of stats. See ESPVGAX::getStats
+static volatile uint32_t statsseq;
+static volatile int statsreset=1;
+// min delay from the expected CCOUNT value. All delays are relative to it
+static int32_t statslatency;
+static bool statsoverrun;
+// CPU cycles of the busy waits of the current vga_handler call
+static uint32_t statswait;
+
+// compiler barrier: stats must be read between two reads of statsseq
+#define STATS_BARRIER() asm volatile("":::"memory")
+
+#define STATS_UPDATE(t0, t1, deadline) stats_update(t0, t1, deadline)
+// measure the busy wait w (see ESPVGAX::Stats::waitCycles)
+#define STATS_WAIT(w) do { \
+    uint32_t tw=TICKS; \
+    w; \
+    statswait+=TICKS-tw; \
+  } while (0)
+
+// deadline is the expected CCOUNT value at the beginning of vga_handler
+static inline void ICACHE_RAM_ATTR stats_update(uint32_t t0, uint32_t t1, 
+  uint32_t deadline) {
+  statsseq++;
+  STATS_BARRIER();
+  if (statsreset) {
+    memset(&stats, 0, sizeof(stats));
+    stats.lineCycles=LINE_CYCLES;
+    stats.minCycles=0xffffffff;
+    statslatency=INT32_MAX;
+    statsoverrun=false;
+    statsreset=0;
+  }
+  uint32_t d=t1-t0;
+  stats.lines++;
+  stats.sumCycles+=d;
+  stats.waitCycles+=statswait;
+  statswait=0;
+  if (d<stats.minCycles)
+    stats.minCycles=d;
+  if (d>stats.maxCycles)
+    stats.maxCycles=d;
+  uint32_t bin=d*ESPVGAX_STATS_BINS/LINE_CYCLES;
+  stats.histogram[bin<ESPVGAX_STATS_BINS ? bin : ESPVGAX_STATS_BINS-1]++;
+  if (d>=LINE_CYCLES)
+    statsoverrun=true;
+  /*
+   * the interrupt latency is unknown but constant: the smallest delay seen
+   * from the expected CCOUNT value is the reference for late lines
+   */
+  int32_t latency=(int32_t)(t0-deadline);
+  if (latency<statslatency)
+    statslatency=latency;
+  uint32_t late=latency-statslatency;
+  if (late>ESPVGAX_STATS_LATE_CYCLES) {
+    stats.lateLines++;
+    if (late>stats.maxLate)
+      stats.maxLate=late;
+    statsoverrun=true;
+  }
+  if (fby==0) {
+    // last line of the frame
+    stats.frames++;
+    if (statsoverrun)
+      stats.overrunFrames++;
+    statsoverrun=false;
+  }
+  STATS_BARRIER();
+  statsseq++;
+}
+void ESPVGAX::getStats(Stats &s) {
+  uint32_t seq;
+  do {
+    seq=statsseq;
+    STATS_BARRIER();
+    s=stats;
+    STATS_BARRIER();
+  } while ((seq & 1) || seq!=statsseq);
+}
+void ESPVGAX::resetStats() {
+  statsreset=1;
+}
+#else // ESPVGAX_STATS not defined
+
+#define STATS_UPDATE(t0, t1, deadline) ((void)(deadline))
+#define STATS_WAIT(w) w
+
+void ESPVGAX::getStats(Stats &s) {
+  memset(&s, 0, sizeof(s));
+}
+void ESPVGAX::resetStats() {
+}
+#endif
@@ -0,0 +1,112 @@
+//file included from ESPVGAX.cpp
+
+#define TEXT_FH ESPVGAX_TEXT_FONT_HEIGHT
+#define TEXT_CELLS (ESPVGAX_TEXT_ROWS*ESPVGAX_TEXT_COLS)
+
+volatile uint8_t ESPVGAX_ALIGN32
+  ESPVGAX::text[ESPVGAX_TEXT_ROWS][ESPVGAX_TEXT_COLS];
+#ifdef ESPVGAX_TEXT_ATTRIBUTES
+volatile uint8_t ESPVGAX_ALIGN32
+  ESPVGAX::textAttr[ESPVGAX_TEXT_ROWS][ESPVGAX_TEXT_COLS];
+#endif
+/*
+ * RAM copy of the font glyphs, by glyph line: textfont[gy][c] is the line gy
+ * of the character c. Reading the font from FLASH inside vga_handler would
+ * stall on the FLASH cache misses
+ */
+static uint8_t ESPVGAX_ALIGN32 textfont[TEXT_FH][256];
+// line composed by text_line, copied to HSPI by HSPI_VGA_prepare
+static volatile uint32_t ESPVGAX_ALIGN32 textline[ESPVGAX_WWIDTH];
+// framebuffer row and frame of textline
+static int textrow=-1;
+static uint32_t textframe;
+
+/*
+ * compose the framebuffer row (a line of glyphs) in textline, after the
+ * pixeldata of the previous line has been sent. Each byte of the line is a
+ * glyph line, so a 32bit word is made of 4 glyph lines, in the big endian
+ * byte order of fbw. A row displayed two times (ESPVGAX_YSHIFT 1) is
+ * composed only once
+ */
+static volatile uint32_t* ICACHE_RAM_ATTR text_line(int row) {
+  if (row==textrow && frames==textframe)
+    return textline;
+  int r=row/TEXT_FH;
+  if (r>=ESPVGAX_TEXT_ROWS)
+    return empty;
+  int gy=row-r*TEXT_FH;
+  const uint8_t *g=textfont[gy];
+  const volatile uint32_t *t=(const volatile uint32_t*)ESPVGAX::text[r];
+#ifdef ESPVGAX_TEXT_ATTRIBUTES
+  const volatile uint32_t *a=(const volatile uint32_t*)ESPVGAX::textAttr[r];
+  uint8_t under=gy==TEXT_FH-1 ? 0xff : 0;
+#endif
+  for (int i=0; i!=ESPVGAX_WWIDTH; i++) {
+    uint32_t c=t[i];
+    uint32_t w=g[c & 0xff] | g[(c>>8) & 0xff]<<8 | g[(c>>16) & 0xff]<<16 |
+      (uint32_t)g[c>>24]<<24;
+#ifdef ESPVGAX_TEXT_ATTRIBUTES
+    uint32_t at=a[i];
+    if (at) {
+      uint32_t m=0;
+      for (int s=0; s!=32; s+=8) {
+        uint8_t ab=at>>s;
+        if (ab & ESPVGAX_ATTR_UNDERLINE)
+          w|=(uint32_t)under<<s;
+        if (ab & ESPVGAX_ATTR_INVERSE)
+          m|=0xffu<<s;
+      }
+      w^=m;
+    }
+#endif
+    textline[i]=w;
+  }
+  ESPVGAX_HOST_TEXT(ESPVGAX_WWIDTH);
+  textrow=row;
+  textframe=frames;
+  return textline;
+}
+void ESPVGAX::setTextFont(ESPVGAX_PROGMEM uint8_t *bitmap) {
+  // same glyphs layout of setBitmapFont: 16 rows of 16 glyphs
+  for (int c=0; c!=256; c++)
+    for (int gy=0; gy!=TEXT_FH; gy++)
+      textfont[gy][c]=pgm_read_byte(bitmap+(TEXT_FH*(c/16)+gy)*16+c%16);
+  textrow=-1;
+}
+void ESPVGAX::clearText(uint8_t c, uint8_t attr) {
+  memset((void*)text, c, TEXT_CELLS);
+#ifdef ESPVGAX_TEXT_ATTRIBUTES
+  memset((void*)textAttr, attr, TEXT_CELLS);
+#else
+  (void)attr;
+#endif
+}
+#ifdef ESPVGAX_TEXT_ATTRIBUTES
+#define TEXT_SET_ATTR(i, attr) ((volatile uint8_t*)textAttr)[i]=attr
+#else
+#define TEXT_SET_ATTR(i, attr) (void)(attr)
+#endif
+#define PRINTTEXTMETHOD(reader) \
+  if (col<0 || row<0 || col>=ESPVGAX_TEXT_COLS) \
+    return; \
+  int i=row*ESPVGAX_TEXT_COLS+col; \
+  char c; \
+  while ((c=reader(str++)) && i<TEXT_CELLS) { \
+    if (c=='\n') { \
+      i+=ESPVGAX_TEXT_COLS-i%ESPVGAX_TEXT_COLS; \
+    } else { \
+      ((volatile uint8_t*)text)[i]=c; \
+      TEXT_SET_ATTR(i, attr); \
+      i++; \
+    } \
+  }
+#define TEXT_READ_P(p) ((char)pgm_read_byte(p))
+#define TEXT_READ(p) (*(p))
+
+void ESPVGAX::printText_P(ESPVGAX_PROGMEM const char *str, int col, int row,
+  uint8_t attr) {
+  PRINTTEXTMETHOD(TEXT_READ_P)
+}
+void ESPVGAX::printText(const char *str, int col, int row, uint8_t attr) {
+  PRINTTEXTMETHOD(TEXT_READ)
+}
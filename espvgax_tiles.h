@@ -0,0 +1,141 @@
+//file included from ESPVGAX.cpp
+
+#define TILE_H ESPVGAX_TILE_HEIGHT
+// map size in pixels
+#define TILEMAP_W (ESPVGAX_TILEMAP_COLS*8)
+#define TILEMAP_H (ESPVGAX_TILEMAP_ROWS*TILE_H)
+/*
+ * line buffers of the composed lines. The next line is always composed in
+ * the buffer that is not displayed, so the HSPI never sends a line while it
+ * is written
+ */
+#define TILE_RING 2
+
+volatile uint8_t ESPVGAX_ALIGN32
+  ESPVGAX::tileMap[ESPVGAX_TILEMAP_ROWS][ESPVGAX_TILEMAP_COLS];
+uint8_t ESPVGAX_ALIGN32 ESPVGAX::tileSet[ESPVGAX_TILES][ESPVGAX_TILE_HEIGHT];
+
+struct TileSprite {
+  const uint16_t *bitmap;
+  const uint16_t *mask;
+  int16_t x, y;
+  uint8_t height;
+  bool visible;
+};
+static TileSprite sprites[ESPVGAX_SPRITES];
+// map pixel displayed at the top left corner, see ESPVGAX::setTileScroll
+static uint32_t tilescrollx, tilescrolly;
+static volatile uint32_t ESPVGAX_ALIGN32 tilelines[TILE_RING][ESPVGAX_WWIDTH];
+static int tileslot;
+// framebuffer row and frame of tilelines[tileslot]
+static int tilerow=-1;
+static uint32_t tileframe;
+
+// draw the line sy of the sprite s on the line bytes l
+static inline void ICACHE_RAM_ATTR tile_sprite(volatile uint8_t *l,
+  const TileSprite &s, int sy) {
+  int sh=8-(s.x & 7);
+  uint32_t v=(uint32_t)s.bitmap[sy]<<sh;
+  uint32_t m=s.mask ? (uint32_t)s.mask[sy]<<sh : v;
+  // 16 pixels over 3 bytes, from the most significant one
+  int b=s.x>>3;
+  for (int k=16; k>=0; k-=8, b++) {
+    if ((uint32_t)b<ESPVGAX_BWIDTH)
+      l[b]=(l[b] & ~(m>>k)) | (v>>k);
+  }
+}
+/*
+ * compose the framebuffer row from the map, scrolled by tilescrollx and
+ * tilescrolly, then draw the sprites over it. The map row is composed 4
+ * tiles at a time: each byte is a tile line, joined with the next one when
+ * the horizontal scroll is not a multiple of 8 pixels. A row displayed two
+ * times (ESPVGAX_YSHIFT 1) is composed only once
+ */
+static volatile uint32_t* ICACHE_RAM_ATTR tile_line(int row) {
+  if (row==tilerow && frames==tileframe)
+    return tilelines[tileslot];
+  tileslot=(tileslot+1) % TILE_RING;
+  volatile uint32_t *l=tilelines[tileslot];
+  uint32_t my=row+tilescrolly;
+  while (my>=TILEMAP_H)
+    my-=TILEMAP_H;
+  int r=my/TILE_H;
+  int gy=my-r*TILE_H;
+  const volatile uint8_t *m=ESPVGAX::tileMap[r];
+  const uint8_t *ts=&ESPVGAX::tileSet[0][gy];
+  int col=tilescrollx>>3;
+  int sh=tilescrollx & 7;
+  uint32_t prev=ts[m[col]*TILE_H];
+  for (int i=0; i!=ESPVGAX_WWIDTH; i++) {
+    uint32_t w=0;
+    for (int k=0; k!=32; k+=8) {
+      if (++col==ESPVGAX_TILEMAP_COLS)
+        col=0;
+      uint32_t next=ts[m[col]*TILE_H];
+      w|=((prev<<sh | next>>(8-sh)) & 0xff)<<k;
+      prev=next;
+    }
+    l[i]=w;
+  }
+  ESPVGAX_HOST_TILES(ESPVGAX_WWIDTH);
+  int drawn=0;
+  for (int i=0; i!=ESPVGAX_SPRITES && drawn!=ESPVGAX_LINE_SPRITES; i++) {
+    const TileSprite &s=sprites[i];
+    uint32_t sy=row-s.y;
+    if (s.visible && sy<s.height) {
+      tile_sprite((volatile uint8_t*)l, s, sy);
+      drawn++;
+    }
+  }
+  ESPVGAX_HOST_SPRITES(drawn);
+  tilerow=row;
+  tileframe=frames;
+  return l;
+}
+void ESPVGAX::loadTiles_P(ESPVGAX_PROGMEM uint8_t *src, int first, int count) {
+  if (first<0 || count<=0 || first+count>ESPVGAX_TILES)
+    return;
+  memcpy_P(tileSet[first], src, count*TILE_H);
+}
+void ESPVGAX::loadTiles(const uint8_t *src, int first, int count) {
+  if (first<0 || count<=0 || first+count>ESPVGAX_TILES)
+    return;
+  memcpy(tileSet[first], src, count*TILE_H);
+}
+void ESPVGAX::setTileScroll(int x, int y) {
+  x%=TILEMAP_W;
+  if (x<0)
+    x+=TILEMAP_W;
+  y%=TILEMAP_H;
+  if (y<0)
+    y+=TILEMAP_H;
+  noInterrupts();
+  tilescrollx=x;
+  tilescrolly=y;
+  interrupts();
+}
+void ESPVGAX::setSprite(int n, const uint16_t *bitmap, int height,
+  const uint16_t *mask) {
+  if (n<0 || n>=ESPVGAX_SPRITES || height<0 || height>255)
+    return;
+  noInterrupts();
+  sprites[n].bitmap=bitmap;
+  sprites[n].mask=mask;
+  sprites[n].height=bitmap ? height : 0;
+  sprites[n].visible=false;
+  interrupts();
+}
+void ESPVGAX::moveSprite(int n, int x, int y) {
+  if (n<0 || n>=ESPVGAX_SPRITES)
+    return;
+  noInterrupts();
+  sprites[n].x=x;
+  sprites[n].y=y;
+  sprites[n].visible=true;
+  interrupts();
+}
+void ESPVGAX::hideSprite(int n) {
+  if (n<0 || n>=ESPVGAX_SPRITES)
+    return;
+  sprites[n].visible=false;
+}
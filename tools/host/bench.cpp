@@ -0,0 +1,502 @@
+/*
+ * bench: drawing primitives microbenchmark
+ *
+ * Runs on a PC, through the host backend (see espvgax_host.h), the same
+ * workloads of the test_* and blit_bench functions of examples/Demo:
+ * putpixel/putpixel8/putpixel32, clear, aligned (BLIT32) and unaligned
+ * (BLITUNALIGNED) blit and blit_P for each ESPVGAX_OP_*, draw_row and
+ * draw_column (through drawLine), drawLine, drawCircle, drawRect, invertRect,
+ * scrollUp, scrollLeft, print and print_P. For each workload it reports:
+ *    - ns/op: nanoseconds for a single call
+ *    - Mpx/s: millions of pixels processed per second
+ *    - words: framebuffer 32bit words modified by a single call (average)
+ *    - calib: ns for an iteration of a fixed calibration loop, measured
+ *      between the repetitions of the workload
+ *    - cost: ns/op relative to calib, the median of 9 repetitions. This
+ *      value does not depend (too much) on the speed of the PC and is 
+ *      compared with the baseline
+ *
+ * Before the workloads, 300 random fillRect, invertRect and scrollRect calls
+ * (clipped rectangles, all the ops, of any width) are compared with a model
+ * of the framebuffer written pixel by pixel: if a call leaves a different
+ * pixel the exit code is 1, whatever the baseline.
+ *
+ * Build and run from the library folder:
+ *    g++ -std=c++17 -O2 -DESPVGAX_HOST -I. ESPVGAX.cpp tools/host/bench.cpp \
+ *      -o bench
+ *    ./bench [-b baseline.txt] [-w baseline.txt] [-t tolerance%] [workload]
+ *
+ * -b compares the results with a stored baseline and exits with code 1 if 
+ * the number of modified words of a workload is different (a functional
+ * regression) or if its cost is over the baseline by more than the 
+ * tolerance (-t, 100% by default: two times slower). The words do not
+ * depend on the PC, the cost does: on a shared or throttled PC it changes 
+ * by 50% between two runs, so a workload over the tolerance is measured a 
+ * second time, and the workloads more than 25% slower are only reported.
+ * -w writes the results as the new baseline, write it in the same commit 
+ * that changes the measured code. The default baseline is 
+ * tools/host/bench_baseline.txt
+ */
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "ESPVGAX.h"
+#include "fonts/arial12.h"
+#include "fonts/monodos8.h"
+
+#define IMG_WIDTH 128
+#define IMG_BWIDTH 16
+#define IMG_HEIGHT 126
+static uint8_t ESPVGAX_ALIGN32 img[IMG_HEIGHT][IMG_BWIDTH];
+
+static const char ESPVGAX_ALIGN32 str0[] PROGMEM="ESPVGAX Version 1.0\n"
+  "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod "
+  "tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim "
+  "veniam, quis nostrud exercitation ullamco laboris nisi ut aliquip ex ea "
+  "commodo consequat.";
+static char matrix[60][64];
+
+static int rnd(int n) {
+  return ESPVGAX::rand() % n;
+}
+static int randx() { return rnd(ESPVGAX_WIDTH); }
+static int randy() { return rnd(ESPVGAX_HEIGHT); }
+
+/*
+ * each workload function draws something and returns the number of pixels
+ * processed
+ */
+typedef long (*Workload)(int op);
+
+static long putpixel(int op) {
+  ESPVGAX::putpixel(randx(), randy(), rnd(2), op);
+  return 1;
+}
+static long putpixel8(int op) {
+  ESPVGAX::putpixel8(rnd(ESPVGAX_BWIDTH), randy(), rnd(256)|0x80, op);
+  return 8;
+}
+static long putpixel32(int op) {
+  ESPVGAX::putpixel32(rnd(ESPVGAX_WWIDTH), randy(), ESPVGAX::rand()|0x80, op);
+  return 32;
+}
+static long clear(int) {
+  ESPVGAX::clear(ESPVGAX::rand()|0x80);
+  return ESPVGAX_WIDTH*ESPVGAX_HEIGHT;
+}
+static long blitAligned_P(int op) {
+  ESPVGAX::blit_P((uint8_t*)img, 32*rnd(ESPVGAX_WWIDTH), randy()-100,
+    IMG_WIDTH, IMG_HEIGHT, op);
+  return IMG_WIDTH*IMG_HEIGHT;
+}
+static long blitUnaligned_P(int op) {
+  ESPVGAX::blit_P((uint8_t*)img, -100+rnd(ESPVGAX_WIDTH+200),
+    -100+rnd(ESPVGAX_HEIGHT+200), IMG_WIDTH, IMG_HEIGHT, op);
+  return IMG_WIDTH*IMG_HEIGHT;
+}
+static long blitAligned(int op) {
+  ESPVGAX::blit((uint8_t*)img, 32*rnd(ESPVGAX_WWIDTH), randy()-100,
+    IMG_WIDTH, IMG_HEIGHT, op);
+  return IMG_WIDTH*IMG_HEIGHT;
+}
+static long blitUnaligned(int op) {
+  ESPVGAX::blit((uint8_t*)img, -100+rnd(ESPVGAX_WIDTH+200),
+    -100+rnd(ESPVGAX_HEIGHT+200), IMG_WIDTH, IMG_HEIGHT, op);
+  return IMG_WIDTH*IMG_HEIGHT;
+}
+static long glyph_P(int op) {
+  // blit_bench: a single 16x12 glyph of arial12
+  ESPVGAX::blit_P(4+(4+2*12)*31+(uint8_t*)fnt_arial12_data, randx(), randy(),
+    16, 12, op);
+  return 16*12;
+}
+static long drawRow(int op) {
+  int x=randx(), y=randy(), w=1+rnd(ESPVGAX_WIDTH);
+  ESPVGAX::drawLine(x-w/2, y, x+w/2, y, 1, op);
+  return w;
+}
+static long drawColumn(int op) {
+  int x=randx(), y=randy(), h=1+rnd(ESPVGAX_HEIGHT);
+  ESPVGAX::drawLine(x, y-h/2, x, y+h/2, 1, op);
+  return h;
+}
+static long drawLine(int op) {
+  int x0=randx(), y0=randy(), x1=randx(), y1=randy();
+  ESPVGAX::drawLine(x0, y0, x1, y1, 1, op);
+  return std::max(abs(x1-x0), abs(y1-y0));
+}
+static long drawCircle(int op) {
+  int r=3+rnd(120);
+  ESPVGAX::drawCircle(randx()-30, randy()-30, r, 1, false, op);
+  return 6*r;
+}
+static long fillCircle(int op) {
+  int r=3+rnd(120);
+  ESPVGAX::drawCircle(randx()-30, randy()-30, r, 1, true, op);
+  return 3*r*r;
+}
+static long drawRect(int op) {
+  int w=2+rnd(120), h=2+rnd(120);
+  ESPVGAX::drawRect(randx()-30, randy()-30, w, h, 1, false, op);
+  return 2*(w+h);
+}
+static long fillRect(int op) {
+  int w=2+rnd(120), h=2+rnd(120);
+  ESPVGAX::drawRect(randx()-30, randy()-30, w, h, 1, true, op);
+  return w*h;
+}
+static long invertRect(int) {
+  int w=2+rnd(120), h=2+rnd(120);
+  ESPVGAX::invertRect(randx()-30, randy()-30, w, h);
+  return w*h;
+}
+static long scrollUp(int) {
+  ESPVGAX::scrollUp(1+rnd(16));
+  return (long)ESPVGAX_WIDTH*ESPVGAX_HEIGHT;
+}
+static long scrollLeft(int) {
+  ESPVGAX::scrollLeft(1+rnd(16));
+  return (long)ESPVGAX_WIDTH*ESPVGAX_HEIGHT;
+}
+static long print_P(int op) {
+  ESPVGAX::setFont((uint8_t*)fnt_arial12_data, FNT_ARIAL12_SYMBOLS_COUNT,
+    FNT_ARIAL12_HEIGHT, FNT_ARIAL12_GLYPH_WIDTH);
+  ESPVGAX::PrintInfo pi=ESPVGAX::print_P(str0, rnd(32), randy()-60, true, -1,
+    op);
+  return (pi.y+FNT_ARIAL12_HEIGHT)*(long)ESPVGAX_WIDTH;
+}
+static long print(int op) {
+  // test_print_RAM: a 64x60 characters matrix with a monospaced font
+  ESPVGAX::setBitmapFont((uint8_t*)img_monodos8_data, 8);
+  ESPVGAX::print((char*)matrix, 0, 0, true, 60*64, op);
+  return ESPVGAX_WIDTH*ESPVGAX_HEIGHT;
+}
+
+class Bench {
+public:
+  const char *name;
+  Workload fn;
+  int op;
+};
+#define OPS(name, fn) \
+  { name "/set", fn, ESPVGAX_OP_SET }, \
+  { name "/or", fn, ESPVGAX_OP_OR }, \
+  { name "/xor", fn, ESPVGAX_OP_XOR }
+static const Bench benchs[]={
+  OPS("putpixel", putpixel),
+  OPS("putpixel8", putpixel8),
+  OPS("putpixel32", putpixel32),
+  { "clear", clear, 0 },
+  OPS("blit_P.aligned", blitAligned_P),
+  OPS("blit_P.unaligned", blitUnaligned_P),
+  OPS("blit_P.glyph", glyph_P),
+  { "blit.aligned/set", blitAligned, ESPVGAX_OP_SET },
+  { "blit.unaligned/set", blitUnaligned, ESPVGAX_OP_SET },
+  OPS("draw_row", drawRow),
+  OPS("draw_column", drawColumn),
+  OPS("drawLine", drawLine),
+  OPS("drawCircle", drawCircle),
+  OPS("drawCircle.fill", fillCircle),
+  OPS("drawRect", drawRect),
+  OPS("drawRect.fill", fillRect),
+  { "invertRect", invertRect, ESPVGAX_OP_XOR },
+  { "scrollUp", scrollUp, ESPVGAX_OP_SET },
+  { "scrollLeft", scrollLeft, ESPVGAX_OP_SET },
+  OPS("print_P", print_P),
+  { "print/set", print, ESPVGAX_OP_SET },
+};
+#define BENCHS_COUNT (int)(sizeof(benchs)/sizeof(benchs[0]))
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec*1e9+ts.tv_nsec;
+}
+/*
+ * fixed integer workload used to normalize timings. The cost column is the
+ * ratio between the time of a workload call and the time of this loop
+ */
+static volatile uint32_t calibrationSink;
+
+// nanoseconds for a single iteration of the calibration loop
+static double calibrate() {
+  double t0=now();
+  uint32_t v=1;
+  for (int i=0; i!=1000000; i++)
+    v=v*1103515245+12345+(v>>16);
+  calibrationSink=v;
+  return (now()-t0)/1000000;
+}
+// fill the framebuffer with a noise pattern (or its complement)
+static void noise(uint32_t seed, bool invert) {
+  ESPVGAX::srand(seed);
+  for (int y=0; y!=ESPVGAX_HEIGHT; y++)
+    for (int x=0; x!=ESPVGAX_WWIDTH; x++)
+      ESPVGAX::fbw[y][x]=ESPVGAX::rand() ^ (invert ? 0xffffffff : 0);
+}
+/*
+ * average framebuffer words modified by a call. The workload is run over
+ * two complementary noise patterns, so each word written with a value
+ * different from the previous one is counted, whatever its pixels are
+ */
+static double modifiedWords(const Bench &b) {
+  static uint32_t before[ESPVGAX_HEIGHT][ESPVGAX_WWIDTH];
+  static uint8_t changed[ESPVGAX_HEIGHT][ESPVGAX_WWIDTH];
+  const int calls=16;
+  long total=0;
+  for (int c=0; c!=calls; c++) {
+    memset(changed, 0, sizeof(changed));
+    for (int inv=0; inv!=2; inv++) {
+      noise(1234, inv);
+      memcpy(before, (void*)ESPVGAX::fbw, sizeof(before));
+      ESPVGAX::srand(100+c);
+      b.fn(b.op);
+      for (int y=0; y!=ESPVGAX_HEIGHT; y++)
+        for (int x=0; x!=ESPVGAX_WWIDTH; x++)
+          changed[y][x]|=before[y][x]!=ESPVGAX::fbw[y][x];
+    }
+    for (int y=0; y!=ESPVGAX_HEIGHT; y++)
+      for (int x=0; x!=ESPVGAX_WWIDTH; x++)
+        total+=changed[y][x];
+  }
+  return (double)total/calls;
+}
+/*
+ * per-pixel model of the framebuffer, to check fillRect, invertRect and 
+ * scrollRect: their head and tail masks and the funnel shift of scrollRect
+ * are compared with pixels written one by one
+ */
+static uint8_t model[ESPVGAX_HEIGHT][ESPVGAX_WIDTH];
+
+static void modelFill(int x, int y, int w, int h, uint8_t c, int op) {
+  c=ESPVGAX_PIXEL(c);
+  for (int py=y; py<y+h; py++)
+    for (int px=x; px<x+w; px++) {
+      if (ESPVGAX::isXOutside(px) || ESPVGAX::isYOutside(py))
+        continue;
+      uint8_t &p=model[py][px];
+      p=op==ESPVGAX_OP_OR ? p|c : (op==ESPVGAX_OP_XOR ? p^c : c);
+    }
+}
+static void modelScroll(int x, int y, int w, int h, int dx, int dy, 
+  uint8_t c) {
+  static uint8_t src[ESPVGAX_HEIGHT][ESPVGAX_WIDTH];
+  int x1=std::min(x+w, ESPVGAX_WIDTH), y1=std::min(y+h, ESPVGAX_HEIGHT);
+  x=std::max(x, 0);
+  y=std::max(y, 0);
+  memcpy(src, model, sizeof(src));
+  for (int py=y; py<y1; py++)
+    for (int px=x; px<x1; px++) {
+      int sx=px-dx, sy=py-dy;
+      bool inside=sx>=x && sx<x1 && sy>=y && sy<y1;
+      model[py][px]=inside ? src[sy][sx] : ESPVGAX_PIXEL(c);
+    }
+}
+/*
+ * random rectangles, clipped by the screen too, of all the widths from a 
+ * single pixel to the whole line. Returns the number of calls that leave 
+ * the framebuffer different from the model
+ */
+static int referenceCheck(int calls) {
+  noise(4321, false);
+  for (int y=0; y!=ESPVGAX_HEIGHT; y++)
+    for (int x=0; x!=ESPVGAX_WIDTH; x++)
+      model[y][x]=ESPVGAX::getpixel(x, y);
+  ESPVGAX::srand(5678);
+  int wrong=0;
+  for (int i=0; i!=calls; i++) {
+    int w=rnd(8)==0 ? ESPVGAX_WIDTH : 1+rnd(rnd(2) ? 3*ESPVGAX_WORD_PIXELS :
+      ESPVGAX_WIDTH);
+    int h=1+rnd(rnd(2) ? 8 : ESPVGAX_HEIGHT);
+    int x=w==ESPVGAX_WIDTH && rnd(2) ? 0 : rnd(ESPVGAX_WIDTH+40)-w/2-20;
+    int y=rnd(ESPVGAX_HEIGHT+40)-h/2-20;
+    int dx=rnd(4)==0 ? 0 : rnd(2*w+4)-w-2;
+    int dy=rnd(4)==0 ? 0 : rnd(2*h+4)-h-2;
+    uint8_t c=rnd(256);
+    int op=rnd(3)==0 ? ESPVGAX_OP_OR : (rnd(2) ? ESPVGAX_OP_XOR : 
+      ESPVGAX_OP_SET);
+    const char *name;
+    switch (rnd(3)) {
+    case 0:
+      name="fillRect";
+      ESPVGAX::fillRect(x, y, w, h, c, op);
+      modelFill(x, y, w, h, c, op);
+      break;
+    case 1:
+      name="invertRect";
+      ESPVGAX::invertRect(x, y, w, h);
+      modelFill(x, y, w, h, ESPVGAX_PIXEL_MASK, ESPVGAX_OP_XOR);
+      break;
+    default:
+      name="scrollRect";
+      ESPVGAX::scrollRect(x, y, w, h, dx, dy, c);
+      modelScroll(x, y, w, h, dx, dy, c);
+      break;
+    }
+    bool same=true;
+    for (int py=0; same && py!=ESPVGAX_HEIGHT; py++)
+      for (int px=0; same && px!=ESPVGAX_WIDTH; px++)
+        same=model[py][px]==ESPVGAX::getpixel(px, py);
+    if (!same) {
+      if (wrong<5)
+        printf("reference check: call %d, %s(%d, %d, %d, %d), dx %d, dy %d, "
+          "differs\n", i, name, x, y, w, h, dx, dy);
+      wrong++;
+      // go on from the framebuffer content
+      for (int py=0; py!=ESPVGAX_HEIGHT; py++)
+        for (int px=0; px!=ESPVGAX_WIDTH; px++)
+          model[py][px]=ESPVGAX::getpixel(px, py);
+    }
+  }
+  return wrong;
+}
+class Result {
+public:
+  std::string name;
+  double ns, mpx, words, calib, cost;
+};
+static Result run(const Bench &b) {
+  Result r;
+  r.name=b.name;
+  r.words=modifiedWords(b);
+  // find the number of calls that takes at least 20ms
+  long calls=1;
+  for (;;) {
+    ESPVGAX::srand(1);
+    double t0=now();
+    for (long i=0; i!=calls; i++)
+      b.fn(b.op);
+    if (now()-t0>20e6)
+      break;
+    calls*=2;
+  }
+  /*
+   * the calibration loop runs before each repetition of the workload, so
+   * that both see the same CPU frequency and load. The cost is the median
+   * of the repetitions, a single slow one (preemption, frequency change)
+   * does not move it
+   */
+  const int reps=9;
+  double ns[reps], costs[reps], calibs[reps];
+  long pixels=0;
+  for (int k=0; k!=reps; k++) {
+    calibs[k]=calibrate();
+    ESPVGAX::srand(1);
+    pixels=0;
+    double t0=now();
+    for (long i=0; i!=calls; i++)
+      pixels+=b.fn(b.op);
+    ns[k]=(now()-t0)/calls;
+    costs[k]=ns[k]/calibs[k];
+  }
+  std::sort(ns, ns+reps);
+  std::sort(costs, costs+reps);
+  std::sort(calibs, calibs+reps);
+  r.ns=ns[reps/2];
+  r.mpx=pixels/calls/r.ns*1e3;
+  r.cost=costs[reps/2];
+  r.calib=calibs[reps/2];
+  return r;
+}
+static bool loadBaseline(const char *filename, std::vector<Result> &res) {
+  FILE *f=fopen(filename, "r");
+  if (!f)
+    return false;
+  char name[128];
+  Result r;
+  while (fscanf(f, "%127s %lf %lf", name, &r.cost, &r.words)==3) {
+    r.name=name;
+    res.push_back(r);
+  }
+  fclose(f);
+  return true;
+}
+int main(int argc, char **argv) {
+  const char *baseline="tools/host/bench_baseline.txt";
+  const char *write=0;
+  const char *only=0;
+  // tolerance of the cost in percent, over the baseline
+  double tolerance=100;
+  for (int i=1; i<argc; i++) {
+    if (!strcmp(argv[i], "-b") && i+1<argc)
+      baseline=argv[++i];
+    else if (!strcmp(argv[i], "-w") && i+1<argc)
+      write=argv[++i];
+    else if (!strcmp(argv[i], "-t") && i+1<argc)
+      tolerance=atof(argv[++i]);
+    else
+      only=argv[i];
+  }
+  for (int y=0; y!=IMG_HEIGHT; y++)
+    for (int x=0; x!=IMG_BWIDTH; x++)
+      img[y][x]=(uint8_t)(x*7+y*13) | 0x81;
+  for (int y=0; y!=60; y++)
+    for (int x=0; x!=64; x++)
+      matrix[y][x]=(char)(33+(x*31+y*17) % 90);
+  matrix[59][63]=0;
+
+  // the output of the primitives first, then their speed
+  const int checks=300;
+  int wrong=referenceCheck(checks);
+  printf("reference check: %d of %d fillRect, invertRect and scrollRect "
+    "calls differ\n\n", wrong, checks);
+
+  std::vector<Result> base;
+  bool hasBase=!write && loadBaseline(baseline, base);
+  printf("%-24s %12s %10s %10s %8s %10s", "workload", "ns/op", "Mpx/s",
+    "words", "calib", "cost");
+  if (hasBase)
+    printf(" %10s", "baseline");
+  printf("\n");
+  std::vector<Result> res;
+  int fails=0, slower=0;
+  for (int i=0; i!=BENCHS_COUNT; i++) {
+    if (only && !strstr(benchs[i].name, only))
+      continue;
+    Result r=run(benchs[i]);
+    const Result *b=0;
+    for (size_t k=0; hasBase && k!=base.size(); k++)
+      if (base[k].name==r.name)
+        b=&base[k];
+    // a cost over the tolerance must be confirmed by a second run
+    if (b && r.cost>b->cost*(1+tolerance/100)) {
+      Result again=run(benchs[i]);
+      if (again.cost<r.cost)
+        r=again;
+    }
+    res.push_back(r);
+    printf("%-24s %12.1f %10.2f %10.2f %8.3f %10.2f", r.name.c_str(), r.ns,
+      r.mpx, r.words, r.calib, r.cost);
+    if (b) {
+      bool regress=r.cost>b->cost*(1+tolerance/100);
+      bool slow=r.cost>b->cost*1.25;
+      bool differ=std::abs(r.words-b->words)>0.005;
+      printf(" %10.2f %s", b->cost, differ ? "WORDS DIFFER" :
+        (regress ? "SLOWER" : (slow ? "slower" : "ok")));
+      fails+=(differ || regress) ? 1 : 0;
+      slower+=(slow && !regress) ? 1 : 0;
+    }
+    printf("\n");
+  }
+  if (write) {
+    FILE *f=fopen(write, "w");
+    if (!f) {
+      printf("cannot write %s\n", write);
+      return 1;
+    }
+    for (size_t k=0; k!=res.size(); k++)
+      fprintf(f, "%s %.3f %.4f\n", res[k].name.c_str(), res[k].cost,
+        res[k].words);
+    fclose(f);
+    printf("\nbaseline written to %s\n", write);
+  } else if (hasBase) {
+    printf("\n%d regressions (cost tolerance %.0f%%), %d workloads slower "
+      "than 25%%\n", fails, tolerance, slower);
+  } else {
+    printf("\nno baseline found (%s)\n", baseline);
+  }
+  return (fails || wrong) ? 1 : 0;
+}
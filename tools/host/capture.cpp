@@ -0,0 +1,433 @@
+/*
+ * capture: run ESPVGAX on a PC and check the VGA output
+ *
+ * Draws a test screen using the drawing primitives, runs vga_handler for one
+ * VGA frame through the host backend (see espvgax_host.h) and compares the
+ * pixels shifted out by the emulated HSPI with the framebuffer content (and
+ * with ESPVGAX_WINDOW_FILL outside of the framebuffer window). With
+ * ESPVGAX_TEXT_MODE the test screen is made of characters, and the expected
+ * framebuffer is drawn from the font bitmap. With ESPVGAX_TILE_MODE the
+ * test screen is a scrolled map of tiles with some sprites, and the expected
+ * framebuffer is drawn pixel by pixel. With ESPVGAX_OVERLAYS some overlays
+ * are displayed too, and merged pixel by pixel in the expected lines. With
+ * ESPVGAX_HSCROLL each line has a random offset, and its expected pixels 
+ * are the framebuffer row rotated by it. With ESPVGAX_DISPLAY_LIST some
+ * parts of the display list are rotated, and each line is expected to show
+ * the row returned by ESPVGAX::getDisplayRow, checked against a model of
+ * the table. With ESPVGAX_SPI_PIPELINE the 
+ * timing is TIMING_640x480_55, so the lines are copied by the HSPI transfer
+ * done interrupt.
+ * With ESPVGAX_DIRTY_MAP the test screen is copied to the displayed buffer by
+ * two incremental commits, the last one of the first and the last word of
+ * some lines only: build it with a wide mode too, for example
+ * -DESPVGAX_MODE=ESPVGAX_MODE_800x480 (25 words for each line) or 
+ * -DESPVGAX_MODE=ESPVGAX_MODE_512x480 -DESPVGAX_BPP=2 (32 words). If a
+ * filename is given, the captured frame is saved as a PBM image (a PGM image
+ * of the pixel colors with ESPVGAX_BPP 2 or 4).
+ *
+ * Build and run from the library folder:
+ *    g++ -std=c++17 -O2 -DESPVGAX_HOST -I. ESPVGAX.cpp tools/host/capture.cpp \
+ *      -o capture
+ *    ./capture frame.pbm
+ *
+ * Exit code is 0 if every visible line has been captured and matches the 
+ * framebuffer, 1 otherwise.
+ */
+#include <stdio.h>
+#include "ESPVGAX.h"
+#include "fonts/arial12.h"
+#if ESPVGAX_TEXT_FONT_HEIGHT==8
+#include "fonts/monodos8.h"
+#define TEXT_FONT ((uint8_t*)img_monodos8_data)
+#else
+#include "fonts/monodos12.h"
+#define TEXT_FONT ((uint8_t*)img_monodos12_data)
+#endif
+#ifdef ESPVGAX_TILE_MODE
+#include "fonts/monodos8.h"
+#endif
+
+// bytes sent for each VGA line
+#define LINE_BYTES (ESPVGAX_LINE_WWIDTH*4)
+
+static const char str[] PROGMEM="ESPVGAX host capture\nThe quick brown fox "
+  "jumps over the lazy dog";
+
+#ifdef ESPVGAX_TEXT_MODE
+static void drawTestScreen() {
+  ESPVGAX::setTextFont(TEXT_FONT);
+  ESPVGAX::clearText('.');
+  for (int c=0; c!=256 && c<ESPVGAX_TEXT_COLS*(ESPVGAX_TEXT_ROWS-3); c++)
+    ESPVGAX::text[3+c/ESPVGAX_TEXT_COLS][c%ESPVGAX_TEXT_COLS]=c;
+  ESPVGAX::printText_P(str, 1, 0, ESPVGAX_ATTR_UNDERLINE);
+  ESPVGAX::printText("inverse", ESPVGAX_TEXT_COLS-4, ESPVGAX_TEXT_ROWS-1, 
+    ESPVGAX_ATTR_INVERSE);
+}
+// framebuffer of the characters, drawn from the font bitmap
+static void drawTextFramebuffer(uint8_t *fb) {
+  memset(fb, 0, ESPVGAX_FBBSIZE);
+  for (int r=0; r!=ESPVGAX_TEXT_ROWS; r++) {
+    for (int col=0; col!=ESPVGAX_TEXT_COLS; col++) {
+      uint8_t c=ESPVGAX::text[r][col];
+      for (int gy=0; gy!=ESPVGAX_TEXT_FONT_HEIGHT; gy++) {
+        uint8_t b=TEXT_FONT[(ESPVGAX_TEXT_FONT_HEIGHT*(c/16)+gy)*16+c%16];
+#ifdef ESPVGAX_TEXT_ATTRIBUTES
+        uint8_t a=ESPVGAX::textAttr[r][col];
+        if ((a & ESPVGAX_ATTR_UNDERLINE) && gy==ESPVGAX_TEXT_FONT_HEIGHT-1)
+          b=0xff;
+        if (a & ESPVGAX_ATTR_INVERSE)
+          b=~b;
+#endif
+        fb[(r*ESPVGAX_TEXT_FONT_HEIGHT+gy)*ESPVGAX_BWIDTH+col]=b;
+      }
+    }
+  }
+}
+#elif defined(ESPVGAX_TILE_MODE)
+#define SCROLL_X 13
+#define SCROLL_Y 21
+static uint8_t tiles[ESPVGAX_TILES][ESPVGAX_TILE_HEIGHT];
+static const uint16_t ball[]={ 0x07e0, 0x1ff8, 0x3ffc, 0x7ffe, 0x7ffe, 0xffff,
+  0xffff, 0xffff, 0xffff, 0xffff, 0xffff, 0x7ffe, 0x7ffe, 0x3ffc, 0x1ff8,
+  0x07e0 };
+static const uint16_t ring[]={ 0x07e0, 0x1818, 0x2004, 0x4002, 0x4002, 0x8001,
+  0x8001, 0x8001, 0x8001, 0x8001, 0x8001, 0x4002, 0x4002, 0x2004, 0x1818,
+  0x07e0 };
+static const int spritex[]={ 40, 48, -5, ESPVGAX_WIDTH-9, 100, 110, 120, 130 };
+static const int spritey[]={ 30, 36, 60, ESPVGAX_HEIGHT-10, 200, 200, 200, 
+  200 };
+
+static void drawTestScreen() {
+  // the glyphs of the 8x8 font, and a pattern below them
+  for (int t=0; t!=ESPVGAX_TILES; t++)
+    for (int gy=0; gy!=ESPVGAX_TILE_HEIGHT; gy++)
+      tiles[t][gy]=gy<8 ? img_monodos8_data[8*(t/16 % 16)+gy][t%16] : 
+        t*37+gy*11;
+  ESPVGAX::loadTiles(tiles[0], 0, ESPVGAX_TILES);
+  for (int r=0; r!=ESPVGAX_TILEMAP_ROWS; r++)
+    for (int c=0; c!=ESPVGAX_TILEMAP_COLS; c++)
+      ESPVGAX::tileMap[r][c]=(r*7+c) % ESPVGAX_TILES;
+  ESPVGAX::setTileScroll(SCROLL_X, SCROLL_Y);
+  // 8 sprites on the line 200, only ESPVGAX_LINE_SPRITES are drawn
+  for (int i=0; i!=8 && i<ESPVGAX_SPRITES; i++) {
+    ESPVGAX::setSprite(i, (i & 1) ? ring : ball, 16, (i & 1) ? ball : 0);
+    ESPVGAX::moveSprite(i, spritex[i], spritey[i]);
+  }
+}
+static void putExpected(uint8_t *fb, int x, int y, bool set) {
+  uint8_t m=0x80>>(x & 7);
+  fb[y*ESPVGAX_BWIDTH+x/8]=set ? fb[y*ESPVGAX_BWIDTH+x/8] | m : 
+    fb[y*ESPVGAX_BWIDTH+x/8] & ~m;
+}
+// framebuffer of the map and of the sprites
+static void drawTileFramebuffer(uint8_t *fb) {
+  const int mapw=ESPVGAX_TILEMAP_COLS*8, maph=ESPVGAX_TILEMAP_ROWS*
+    ESPVGAX_TILE_HEIGHT;
+  for (int y=0; y!=ESPVGAX_HEIGHT; y++) {
+    for (int x=0; x!=ESPVGAX_WIDTH; x++) {
+      int mx=(x+SCROLL_X) % mapw, my=(y+SCROLL_Y) % maph;
+      uint8_t t=ESPVGAX::tileMap[my/ESPVGAX_TILE_HEIGHT][mx/8];
+      putExpected(fb, x, y, tiles[t][my % ESPVGAX_TILE_HEIGHT] & 
+        (0x80>>(mx & 7)));
+    }
+    int drawn=0;
+    for (int i=0; i!=8 && i<ESPVGAX_SPRITES && drawn<ESPVGAX_LINE_SPRITES; 
+      i++) {
+      int sy=y-spritey[i];
+      if (sy<0 || sy>=16)
+        continue;
+      drawn++;
+      uint16_t bits=(i & 1) ? ring[sy] : ball[sy];
+      uint16_t mask=(i & 1) ? ball[sy] : bits;
+      for (int sx=0; sx!=16; sx++) {
+        int x=spritex[i]+sx;
+        if (x>=0 && x<ESPVGAX_WIDTH && (mask & (0x8000>>sx)))
+          putExpected(fb, x, y, bits & (0x8000>>sx));
+      }
+    }
+  }
+}
+#else
+static void drawTestScreen() {
+  ESPVGAX::clear(0);
+#ifdef ESPVGAX_DIRTY_MAP
+  // the primitives below must mark all the words they write
+  ESPVGAX::commit();
+#endif
+  ESPVGAX::drawRect(0, 0, ESPVGAX_WIDTH-1, ESPVGAX_HEIGHT-1, 1);
+  int r=(ESPVGAX_WIDTH<ESPVGAX_HEIGHT ? ESPVGAX_WIDTH : ESPVGAX_HEIGHT)/4;
+  ESPVGAX::drawCircle(ESPVGAX_WIDTH/2, ESPVGAX_HEIGHT/2, r, 
+    ESPVGAX_PIXEL_MASK, true);
+  ESPVGAX::drawLine(0, 0, ESPVGAX_WIDTH-1, ESPVGAX_HEIGHT-1, 1, 
+    ESPVGAX_OP_XOR);
+  ESPVGAX::invertRect(ESPVGAX_WIDTH-53, 21, 37, 30);
+  ESPVGAX::setFont((uint8_t*)fnt_arial12_data, FNT_ARIAL12_SYMBOLS_COUNT, 
+    FNT_ARIAL12_HEIGHT, FNT_ARIAL12_GLYPH_WIDTH);
+  ESPVGAX::print_P(str, 10, 10, true);
+  // unaligned text with two colors
+  ESPVGAX::setFontColor(ESPVGAX_PIXEL_MASK-1, 1);
+  ESPVGAX::print_P(str, 13, ESPVGAX_HEIGHT-40, true);
+  ESPVGAX::setFontColor(ESPVGAX_PIXEL_MASK);
+#ifdef ESPVGAX_DIRTY_MAP
+  /*
+   * commit, then change only the first and the last word of some lines: the
+   * next commit must copy just them (bit 0 and bit ESPVGAX_WWIDTH-1 of the
+   * dirty map, bit 31 with 32 words for each line)
+   */
+  ESPVGAX::commit();
+  ESPVGAX::fillRect(0, ESPVGAX_HEIGHT/3, ESPVGAX_WORD_PIXELS, 9, 
+    ESPVGAX_PIXEL_MASK, ESPVGAX_OP_XOR);
+  ESPVGAX::fillRect(ESPVGAX_WIDTH-ESPVGAX_WORD_PIXELS, ESPVGAX_HEIGHT/3, 
+    ESPVGAX_WORD_PIXELS, 9, ESPVGAX_PIXEL_MASK, ESPVGAX_OP_XOR);
+#endif
+}
+#endif
+// pixel x of a line in display order
+static uint8_t getPixel(const uint8_t *l, int x) {
+  int b=x*ESPVGAX_BPP;
+  return (l[b/8]>>(8-ESPVGAX_BPP-b%8)) & ESPVGAX_PIXEL_MASK;
+}
+static void setPixel(uint8_t *l, int x, uint8_t p) {
+  int b=x*ESPVGAX_BPP;
+  int s=8-ESPVGAX_BPP-b%8;
+  l[b/8]=(l[b/8] & ~(ESPVGAX_PIXEL_MASK<<s)) | p<<s;
+}
+#ifdef ESPVGAX_OVERLAYS
+static uint32_t arrow[32], arrowmask[32];
+static const int overlayx[]={ 100, 110, ESPVGAX_WIDTH-20, -7 };
+static const int overlayy[]={ 50, 60, 100, ESPVGAX_HEIGHT-20 };
+static const int overlayop[]={ ESPVGAX_OP_XOR, ESPVGAX_OP_SET, ESPVGAX_OP_SET,
+  ESPVGAX_OP_OR };
+#define OVERLAYS (ESPVGAX_OVERLAYS<4 ? ESPVGAX_OVERLAYS : 4)
+
+static void showOverlays() {
+  // an arrow, with a mask one pixel larger
+  for (int y=0; y!=32; y++) {
+    arrow[y]=0xffffffff<<(31-y);
+    arrowmask[y]=(0xffffffff<<(31-y)) | (y<31 ? 0x80000000>>(y+1) : 0);
+  }
+  for (int i=0; i!=OVERLAYS; i++) {
+    ESPVGAX::setOverlay(i, arrow, 32, i==1 ? 0 : arrowmask, overlayop[i]);
+    ESPVGAX::moveOverlay(i, overlayx[i], overlayy[i]);
+  }
+}
+// merge the overlays in the expected pixels of the screen row, in place
+static void mergeOverlays(uint8_t *l, int row) {
+  for (int i=0; i!=OVERLAYS; i++) {
+    int oy=row-overlayy[i];
+    if (oy<0 || oy>=32)
+      continue;
+    for (int px=0; px!=ESPVGAX_WORD_PIXELS; px++) {
+      int x=overlayx[i]+px;
+      if (x<0 || x>=ESPVGAX_WIDTH)
+        continue;
+      int os=32-ESPVGAX_BPP*(px+1);
+      uint8_t v=(arrow[oy]>>os) & ESPVGAX_PIXEL_MASK;
+      uint8_t m=i==1 ? ESPVGAX_PIXEL_MASK : 
+        (arrowmask[oy]>>os) & ESPVGAX_PIXEL_MASK;
+      uint8_t p=getPixel(l, x);
+      if (overlayop[i]==ESPVGAX_OP_OR)
+        p|=v;
+      else if (overlayop[i]==ESPVGAX_OP_XOR)
+        p^=v;
+      else
+        p=(p & ~m) | (v & m);
+      setPixel(l, x, p);
+    }
+  }
+}
+#endif
+#ifdef ESPVGAX_HSCROLL
+// horizontal scroll of each VGA line, as passed to setLineScroll
+static int linescroll[480];
+
+/*
+ * random offsets, also negative and larger than the width. With overlays, 
+ * the lines of the first two have the same offset (written in three ways) 
+ * so that they straddle the end of the rotated rows
+ */
+static void scrollLines() {
+  ESPVGAX::srand(7);
+  for (int y=0; y!=480; y++) {
+    linescroll[y]=(int)(ESPVGAX::rand() % (4*ESPVGAX_WIDTH))-2*ESPVGAX_WIDTH;
+#ifdef ESPVGAX_OVERLAYS
+    int row=(y-ESPVGAX_WINDOW_TOP)>>ESPVGAX_YSHIFT;
+    if (y>=ESPVGAX_WINDOW_TOP && row>=overlayy[0] && row<overlayy[1]+32)
+      linescroll[y]=(y % 3)*ESPVGAX_WIDTH-116;
+#endif
+    ESPVGAX::setLineScroll(y, linescroll[y]);
+  }
+}
+#endif
+#ifdef ESPVGAX_DISPLAY_LIST
+// framebuffer row displayed at each VGA line, as expected from the calls below
+static int displayrow[480];
+
+// rotate the lines y0..y1-1 of the model left by n lines
+static void rotateModel(int y0, int y1, int n) {
+  int old[480];
+  int len=y1-y0;
+  memcpy(old, displayrow, sizeof(old));
+  for (int i=0; i!=len; i++)
+    displayrow[y0+i]=old[y0+((i+n) % len+len) % len];
+}
+
+/*
+ * rotate some parts of the window lines, by counts out of their length too,
+ * so that rows wrap around the end of each part, then set two lines
+ * directly. Rotations start from the window lines only: the rows of the 
+ * lines out of the window are not valid
+ */
+static void rotateLines() {
+  int top=ESPVGAX_WINDOW_TOP;
+  int lines=ESPVGAX_HEIGHT<<ESPVGAX_YSHIFT;
+  if (lines>480-top)
+    lines=480-top;
+  for (int y=0; y!=480; y++)
+    displayrow[y]=(y-top)>>ESPVGAX_YSHIFT;
+  const int parts[][3]={
+    { top+10, top+lines/2, 7 },
+    { top+lines/3, top+lines-1, 5-lines },
+    { top, top+lines, lines+3 },
+    { top+lines/4, top+lines/4+2, 1 },
+  };
+  for (unsigned i=0; i!=sizeof(parts)/sizeof(parts[0]); i++) {
+    ESPVGAX::rotateDisplayList(parts[i][0], parts[i][1], parts[i][2]);
+    rotateModel(parts[i][0], parts[i][1], parts[i][2]);
+  }
+  if (!top) {
+    // clipped to the lines 0..9
+    ESPVGAX::rotateDisplayList(-5, 10, -1);
+    rotateModel(0, 10, -1);
+  }
+  ESPVGAX::setDisplayRow(top+1, ESPVGAX_HEIGHT-1);
+  displayrow[top+1]=ESPVGAX_HEIGHT-1;
+  ESPVGAX::setDisplayRow(top+lines-1, 0);
+  displayrow[top+lines-1]=0;
+  // out of the framebuffer, ignored
+  ESPVGAX::setDisplayRow(top+2, ESPVGAX_HEIGHT);
+}
+#endif
+// fill the expected pixels of the VGA line y
+static void expectedLine(uint8_t *dst, const uint8_t *fb, int y) {
+  // ESPVGAX_WINDOW_FILL is a fbw word, the line is in display order
+  uint32_t fill=ESPVGAX_FBW_BIG_ENDIAN(ESPVGAX_WINDOW_FILL);
+  for (int i=0; i!=ESPVGAX_LINE_WWIDTH; i++)
+    memcpy(dst+i*4, &fill, 4);
+  int wy=y-ESPVGAX_WINDOW_TOP;
+  if (wy<0 || wy>=(ESPVGAX_HEIGHT<<ESPVGAX_YSHIFT))
+    return;
+  // the row rotated left by the horizontal scroll of the line
+  uint8_t *l=dst+ESPVGAX_WINDOW_LEFT32*4;
+#ifdef ESPVGAX_DISPLAY_LIST
+  const uint8_t *row=&fb[displayrow[y]*ESPVGAX_BWIDTH];
+#else
+  const uint8_t *row=&fb[(wy>>ESPVGAX_YSHIFT)*ESPVGAX_BWIDTH];
+#endif
+#ifdef ESPVGAX_HSCROLL
+  int scroll=(linescroll[y] % ESPVGAX_WIDTH+ESPVGAX_WIDTH) % ESPVGAX_WIDTH;
+#else
+  int scroll=0;
+#endif
+  for (int x=0; x!=ESPVGAX_WIDTH; x++)
+    setPixel(l, x, getPixel(row, (x+scroll) % ESPVGAX_WIDTH));
+#ifdef ESPVGAX_OVERLAYS
+  // the overlays are at their screen position
+  mergeOverlays(l, wy>>ESPVGAX_YSHIFT);
+#endif
+}
+static int savePBM(const char *filename, uint32_t first) {
+  FILE *f=fopen(filename, "wb");
+  if (!f) 
+    return 0;
+#if ESPVGAX_BPP==1
+  fprintf(f, "P4\n%d %d\n", ESPVGAX_LINE_WIDTH, 480);
+  for (int y=0; y!=480; y++)
+    fwrite(ESPVGAXHost::capture[(first+y) % ESPVGAX_HOST_CAPTURE_LINES], 1, 
+      LINE_BYTES, f);
+#else
+  fprintf(f, "P5\n%d %d\n%d\n", ESPVGAX_LINE_WIDTH, 480, ESPVGAX_PIXEL_MASK);
+  for (int y=0; y!=480; y++) {
+    uint8_t *l=ESPVGAXHost::capture[(first+y) % ESPVGAX_HOST_CAPTURE_LINES];
+    for (int x=0; x!=ESPVGAX_LINE_WIDTH; x++) {
+      int b=x*ESPVGAX_BPP;
+      fputc((l[b/8]>>(8-ESPVGAX_BPP-b%8)) & ESPVGAX_PIXEL_MASK, f);
+    }
+  }
+#endif
+  fclose(f);
+  return 1;
+}
+int main(int argc, char **argv) {
+  static uint8_t expected[ESPVGAX_FBBSIZE];
+#ifdef ESPVGAX_SPI_PIPELINE
+  // a front porch long enough for the transfer done interrupt to copy lines
+  ESPVGAX::begin(ESPVGAX::TIMING_640x480_55);
+#else
+  ESPVGAX::begin();
+#endif
+  drawTestScreen();
+#ifdef ESPVGAX_TEXT_MODE
+  drawTextFramebuffer(expected);
+#elif defined(ESPVGAX_TILE_MODE)
+  drawTileFramebuffer(expected);
+#else
+  // the framebuffer bytes in display order
+  for (int i=0; i!=ESPVGAX_FBBSIZE; i++)
+    expected[i]=ESPVGAX::fbb[ESPVGAX_FBB_INDEX(i)];
+#endif
+#ifdef ESPVGAX_OVERLAYS
+  showOverlays();
+#endif
+#ifdef ESPVGAX_HSCROLL
+  scrollLines();
+#endif
+#ifdef ESPVGAX_DISPLAY_LIST
+  rotateLines();
+#endif
+#ifdef ESPVGAX_DIRTY_MAP
+  // copy the changed words to the front buffer
+  ESPVGAX::commit();
+#elif defined(ESPVGAX_DOUBLE_BUFFER)
+  // show the back buffer
+  ESPVGAX::flip();
+#endif
+  // skip the first frame, then capture a full one
+  ESPVGAXHost::runFrames(1);
+  uint32_t first=ESPVGAXHost::irqs-ESPVGAXHost::irqs % 525;
+  ESPVGAXHost::runFrames(1);
+
+  int errors=0;
+  /*
+   * VGA lines 0..479 show the framebuffer window lines, doubled if 
+   * ESPVGAX_YSHIFT=1
+   */
+  for (int y=0; y!=480; y++) {
+    uint32_t n=(first+y) % ESPVGAX_HOST_CAPTURE_LINES;
+    uint8_t line[LINE_BYTES];
+#ifdef ESPVGAX_DISPLAY_LIST
+    int wy=y-ESPVGAX_WINDOW_TOP;
+    if (wy>=0 && wy<(ESPVGAX_HEIGHT<<ESPVGAX_YSHIFT) && 
+      ESPVGAX::getDisplayRow(y)!=displayrow[y]) {
+      if (errors<10)
+        printf("line %d: display row %d, expected %d\n", y, 
+          ESPVGAX::getDisplayRow(y), displayrow[y]);
+      errors++;
+      continue;
+    }
+#endif
+    expectedLine(line, expected, y);
+    if (!ESPVGAXHost::captured[n] || 
+      memcmp(ESPVGAXHost::capture[n], line, sizeof(line))) {
+      if (errors<10)
+        printf("line %d: wrong or missing pixeldata\n", y);
+      errors++;
+    }
+  }
+  printf("%d lines checked, %d errors\n", 480, errors);
+  if (argc>1 && !savePBM(argv[1], first)) {
+    printf("cannot write %s\n", argv[1]);
+    return 1;
+  }
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,411 @@
+/*
+ * vgasim: check the VGA signal generated by vga_handler against the VGA
+ * timings (see ESPVGAX::ModeTiming)
+ *
+ * vga_handler runs inside the host backend (see espvgax_host.h), where every
+ * busy wait, register access and HSPI copy has a modeled cost in CPU cycles.
+ * The HSYNC/VSYNC edges and the HSPI transfers are recorded with their CCOUNT
+ * timestamp and converted to a per-line timeline, that is checked against 
+ * the timing passed to ESPVGAX::begin. The report shows also how many CPU
+ * cycles are left to the main loop.
+ *
+ * Build and run from the library folder:
+ *    g++ -std=c++17 -O2 -DESPVGAX_HOST -I. ESPVGAX.cpp tools/host/vgasim.cpp \
+ *      -o vgasim
+ *    ./vgasim [-m 480|400|350|864] [-f frames] [-t timeline.csv]
+ *
+ * -m selects the timing: 640x480@60Hz (default), 640x400@70Hz, 
+ * 640x350@70Hz or 640x480@55Hz (hTotal 864, TIMING_640x480_55). With 
+ * ESPVGAX_SPI_PIPELINE and -m 864 it checks that the lines are copied by
+ * the HSPI transfer done interrupt.
+ * Add -DF_CPU=160000000L to simulate the 160MHz CPU, or any of the
+ * ESPVGAX_HOST_*_CYCLES constants to change the cycles cost model. Add
+ * -DESPVGAX_STATS to print also the statistics collected by vga_handler (see
+ * ESPVGAX::getStats).
+ * Exit code is 0 if all checks pass, 1 otherwise.
+ */
+#include <stdio.h>
+#include <vector>
+#include "ESPVGAX.h"
+
+#define CYCLES_PER_US (F_CPU/1000000.0)
+
+// DMT pixel clock tolerance
+#define VESA_TOLERANCE 0.005
+
+class Line {
+public:
+  uint32_t start; // HSYNC pulse begin
+  uint32_t hsyncEnd; // HSYNC pulse end
+  uint32_t dataStart, dataEnd; // HSPI transfers, 0 if none
+  uint32_t seams; // transfers after the first one (wide modes)
+  uint32_t seamMin, seamMax; // cycles between two transfers of the line
+  uint32_t isrBusy; // cycles from timer deadline to the return from ISR
+  uint32_t late; // cycles of delay of the ISR entry
+  uint32_t spiBusy; // cycles of the SPI interrupt (ESPVGAX_SPI_PIPELINE)
+  bool vsync; // VSYNC pulse active at the beginning of the line
+};
+class Check {
+public:
+  const char *name;
+  double value, min, max;
+  const char *unit;
+};
+static std::vector<Check> checks;
+
+static bool check(const char *name, double value, double min, double max,
+  const char *unit) {
+  checks.push_back(Check{name, value, min, max, unit});
+  return value>=min && value<=max;
+}
+static double us(double cycles) {
+  return cycles/CYCLES_PER_US;
+}
+int main(int argc, char **argv) {
+  int frames=2;
+  const char *timeline=0;
+  const ESPVGAX::ModeTiming *t=&ESPVGAX::TIMING_640x480_60;
+  for (int i=1; i<argc; i++) {
+    if (!strcmp(argv[i], "-f") && i+1<argc)
+      frames=atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-m") && i+1<argc) {
+      int m=atoi(argv[++i]);
+      if (m==400)
+        t=&ESPVGAX::TIMING_640x400_70;
+      else if (m==350)
+        t=&ESPVGAX::TIMING_640x350_70;
+      else if (m==864)
+        t=&ESPVGAX::TIMING_640x480_55;
+    }
+    else if (!strcmp(argv[i], "-t") && i+1<argc)
+      timeline=argv[++i];
+  }
+  const double pixelUs=1e6/t->pixelClock;
+  const double lineUs=t->hTotal*pixelUs;
+  const double hsyncUs=t->hSync*pixelUs;
+  const int vsyncLines=t->vSyncEnd-t->vSyncStart;
+  const double frameHz=(double)t->pixelClock/(t->hTotal*t->vTotal);
+  ESPVGAX::begin(*t);
+#ifdef ESPVGAX_TEXT_MODE
+  // the characters are composed by vga_handler, with its cost
+  ESPVGAX::clearText(0xaa);
+#elif defined(ESPVGAX_TILE_MODE)
+  // the map and the sprites are composed by vga_handler, with its cost
+  static const uint16_t sprite[16]={ 0xffff };
+  for (int i=0; i!=ESPVGAX_SPRITES; i++) {
+    ESPVGAX::setSprite(i, sprite, 16);
+    ESPVGAX::moveSprite(i, i*20+3, 0);
+  }
+  ESPVGAX::setTileScroll(3, 0);
+#else
+  ESPVGAX::clear(0xaa);
+#endif
+#ifdef ESPVGAX_OVERLAYS
+  // all overlays on the first 255 lines, the worst case of their cost
+  static const uint32_t overlay[255]={ 0xffffffff };
+  for (int i=0; i!=ESPVGAX_OVERLAYS; i++) {
+    ESPVGAX::setOverlay(i, overlay, 255);
+    ESPVGAX::moveOverlay(i, i*40+3, 0);
+  }
+#endif
+  // let the signal settle, then record
+  ESPVGAXHost::runFrames(1, t->vTotal);
+  ESPVGAXHost::eventscount=0;
+  ESPVGAXHost::spistaged=0;
+  ESPVGAXHost::runFrames(frames, t->vTotal);
+  ESPVGAXHost::runLines(2);
+
+  // detect HSYNC and VSYNC polarity: the pulse is the shortest level
+  const uint32_t hmask=1<<ESPVGAX_HSYNC_PIN, vmask=1<<ESPVGAX_VSYNC_PIN;
+  uint64_t htime[2]={0,0}, vtime[2]={0,0};
+  uint32_t gpo=ESPVGAXHost::events[0].v, last=ESPVGAXHost::events[0].t;
+  for (uint32_t i=0; i!=ESPVGAXHost::eventscount; i++) {
+    ESPVGAXHostEvent &e=ESPVGAXHost::events[i];
+    if (e.type!=ESPVGAX_HOST_EV_GPIO)
+      continue;
+    htime[(gpo & hmask) ? 1 : 0]+=e.t-last;
+    vtime[(gpo & vmask) ? 1 : 0]+=e.t-last;
+    gpo=e.v;
+    last=e.t;
+  }
+  uint32_t hpulse=htime[0]<htime[1] ? 0 : hmask;
+  uint32_t vpulse=vtime[0]<vtime[1] ? 0 : vmask;
+
+  // build the lines timeline
+  std::vector<Line> lines;
+  uint32_t late=0, spientry=0, spicount=0;
+  bool inpulse=false, vsync=false;
+  for (uint32_t i=0; i!=ESPVGAXHost::eventscount; i++) {
+    ESPVGAXHostEvent &e=ESPVGAXHost::events[i];
+    switch (e.type) {
+    case ESPVGAX_HOST_EV_GPIO:
+      vsync=(e.v & vmask)==vpulse;
+      if ((e.v & hmask)==hpulse && !inpulse) {
+        Line l={};
+        l.start=e.t;
+        l.vsync=vsync;
+        l.late=late;
+        lines.push_back(l);
+        inpulse=true;
+      } else if ((e.v & hmask)!=hpulse && inpulse) {
+        lines.back().hsyncEnd=e.t;
+        inpulse=false;
+      }
+      break;
+    case ESPVGAX_HOST_EV_SPI:
+      if (lines.size() && !lines.back().dataStart) {
+        lines.back().dataStart=e.t;
+        lines.back().dataEnd=e.v;
+      } else if (lines.size()) {
+        // next chunk of a wide line
+        Line &l=lines.back();
+        uint32_t gap=e.t-l.dataEnd;
+        l.seamMin=l.seams ? std::min(l.seamMin, gap) : gap;
+        l.seamMax=l.seams ? std::max(l.seamMax, gap) : gap;
+        l.seams++;
+        l.dataEnd=e.v;
+      }
+      break;
+    case ESPVGAX_HOST_EV_IRQ:
+      late=e.t-e.v-ESPVGAX_HOST_IRQ_CYCLES;
+      break;
+    case ESPVGAX_HOST_EV_IRET:
+      if (lines.size())
+        lines.back().isrBusy=e.t+ESPVGAX_HOST_IRET_CYCLES-e.v;
+      break;
+    case ESPVGAX_HOST_EV_SPIIRQ:
+      spientry=e.t-ESPVGAX_HOST_IRQ_CYCLES;
+      spicount++;
+      break;
+    case ESPVGAX_HOST_EV_SPIIRET:
+      if (lines.size())
+        lines.back().spiBusy+=e.t+ESPVGAX_HOST_IRET_CYCLES-spientry;
+      break;
+    }
+  }
+  // last line is used only as end of the previous one
+  if ((int)lines.size()<t->vTotal+2) {
+    printf("not enough lines recorded (%d)\n", (int)lines.size());
+    return 1;
+  }
+  int n=lines.size()-1;
+  FILE *f=timeline ? fopen(timeline, "w") : 0;
+  if (f)
+    fprintf(f, "line,start_us,period_us,hsync_us,vsync,data_start_us,"
+      "data_end_us,front_porch_us,isr_cycles,free_cycles,late_cycles\n");
+  double pmin=1e9, pmax=0, psum=0, hmin=1e9, hmax=0;
+  double bpmin=1e9, fpmin=1e9, dsmin=1e9, dsmax=-1e9, demin=1e9, demax=-1e9;
+  double dlen=0, cmin=1e9, cmax=-1e9;
+  uint64_t busy=0, busymax=0, free=0, lates=0, nodata=0, spibusy=0;
+  double seammin=1e9, seammax=-1e9;
+  for (int i=0; i!=n; i++) {
+    Line &l=lines[i];
+    double period=lines[i+1].start-l.start;
+    double hsync=l.hsyncEnd-l.start;
+    pmin=std::min(pmin, period);
+    pmax=std::max(pmax, period);
+    psum+=period;
+    hmin=std::min(hmin, hsync);
+    hmax=std::max(hmax, hsync);
+    double fp=0;
+    if (l.dataStart) {
+      double bp=(double)l.dataStart-l.hsyncEnd;
+      fp=(double)lines[i+1].start-l.dataEnd;
+      bpmin=std::min(bpmin, bp);
+      fpmin=std::min(fpmin, fp);
+      dsmin=std::min(dsmin, (double)l.dataStart-l.start);
+      dsmax=std::max(dsmax, (double)l.dataStart-l.start);
+      if (l.seams) {
+        seammin=std::min(seammin, (double)(int32_t)l.seamMin);
+        seammax=std::max(seammax, (double)(int32_t)l.seamMax);
+      }
+    } else {
+      nodata++;
+    }
+    busy+=l.isrBusy;
+    busymax=std::max<uint64_t>(busymax, l.isrBusy);
+    spibusy+=l.spiBusy;
+    free+=period>l.isrBusy+l.spiBusy ? period-l.isrBusy-l.spiBusy : 0;
+    if (l.late)
+      lates++;
+    if (f)
+      fprintf(f, "%d,%.3f,%.3f,%.3f,%d,%.3f,%.3f,%.3f,%u,%.0f,%u\n", i,
+        us(l.start-lines[0].start), us(period), us(hsync), l.vsync ? 1 : 0,
+        l.dataStart ? us(l.dataStart-l.start) : 0,
+        l.dataStart ? us(l.dataEnd-l.start) : 0, us(fp),
+        l.isrBusy, period-l.isrBusy, l.late);
+  }
+  if (f)
+    fclose(f);
+  // find VSYNC pulses, measured in lines
+  std::vector<int> vstarts;
+  int vwidth=0, vwidthmin=1000, vwidthmax=0;
+  for (int i=1; i!=n; i++) {
+    if (lines[i].vsync && !lines[i-1].vsync)
+      vstarts.push_back(i);
+    if (lines[i].vsync) {
+      vwidth++;
+    } else if (vwidth) {
+      if (vstarts.size() && vstarts.front()<i-vwidth+1) {
+        vwidthmin=std::min(vwidthmin, vwidth);
+        vwidthmax=std::max(vwidthmax, vwidth);
+      }
+      vwidth=0;
+    }
+  }
+  int fmin=100000, fmax=0;
+  double frametime=0;
+  for (size_t i=1; i<vstarts.size(); i++) {
+    int fl=vstarts[i]-vstarts[i-1];
+    fmin=std::min(fmin, fl);
+    fmax=std::max(fmax, fl);
+    frametime=lines[vstarts[i]].start-lines[vstarts[i-1]].start;
+  }
+  /*
+   * pixeldata end, length and center of the lines with all the chunks. The
+   * black line at the beginning of the vertical blank sends only the first
+   * chunk
+   */
+  uint32_t chunks=0;
+  for (int i=0; i!=n; i++)
+    chunks=std::max(chunks, lines[i].seams+1);
+  for (int i=0; i!=n; i++) {
+    Line &l=lines[i];
+    if (!l.dataStart || l.seams+1!=chunks)
+      continue;
+    demin=std::min(demin, (double)l.dataEnd-l.start);
+    demax=std::max(demax, (double)l.dataEnd-l.start);
+    dlen=std::max(dlen, (double)l.dataEnd-l.dataStart);
+    double center=((double)l.dataStart+l.dataEnd)/2-l.start;
+    cmin=std::min(cmin, center);
+    cmax=std::max(cmax, center);
+  }
+  double pavg=psum/n;
+  double tol=VESA_TOLERANCE;
+  printf("ESPVGAX timing simulation, F_CPU=%ldMHz, %d lines\n\n",
+    (long)(F_CPU/1000000), n);
+  printf("timing: %dx%d, %d lines, %.3fMHz pixel clock\n", t->hActive,
+    t->vActive, t->vTotal, t->pixelClock/1e6);
+  printf("HSYNC polarity: %s, VSYNC polarity: %s\n",
+    hpulse ? "positive" : "negative", vpulse ? "positive" : "negative");
+  check("HSYNC polarity", hpulse ? 1 : 0, 
+    (t->polarity & ESPVGAX_HSYNC_POSITIVE) ? 1 : 0,
+    (t->polarity & ESPVGAX_HSYNC_POSITIVE) ? 1 : 0, "");
+  check("VSYNC polarity", vpulse ? 1 : 0, 
+    (t->polarity & ESPVGAX_VSYNC_POSITIVE) ? 1 : 0,
+    (t->polarity & ESPVGAX_VSYNC_POSITIVE) ? 1 : 0, "");
+  check("line period (avg)", us(pavg), lineUs*(1-tol), lineUs*(1+tol), "us");
+  check("line period jitter", us(pmax-pmin), 0, pixelUs, "us");
+  check("HSYNC pulse (min)", us(hmin), hsyncUs-2*pixelUs, hsyncUs+2*pixelUs,
+    "us");
+  check("HSYNC pulse (max)", us(hmax), hsyncUs-2*pixelUs, hsyncUs+2*pixelUs,
+    "us");
+  printf("lines without pixeldata: %llu\n", (unsigned long long)nodata);
+  if (nodata<(uint64_t)n) {
+    /*
+     * the pixeldata is centered in the active pixels, from the end of the
+     * back porch (hSync+hBackPorch) to the beginning of the front porch
+     * (hTotal-hFrontPorch). A line longer than them (25.6us with 512 pixels
+     * at 20MHz, 26.1us with the 4 chunks of ESPVGAX_BPP 4) runs into both 
+     * porches, but it must start after HSYNC and end before the next one,
+     * and leave black at least half of each porch (the monitor reads the 
+     * black level there)
+     */
+    int frontPorch=t->hTotal-t->hActive-t->hSync-t->hBackPorch;
+    double bpUs=t->hBackPorch*pixelUs, fpUs=frontPorch*pixelUs;
+    double startUs=hsyncUs+bpUs, endUs=startUs+t->hActive*pixelUs;
+    double centerUs=(startUs+endUs)/2;
+    printf("pixeldata: %.3fus after HSYNC, %.3fus before next HSYNC, "
+      "%.3fus long\n", us(bpmin), us(fpmin), us(dlen));
+    if (us(dsmin)<startUs || us(demax)>endUs)
+      printf("pixeldata in the porches: %.3fus back, %.3fus front\n", 
+        std::max(0.0, startUs-us(dsmin)), std::max(0.0, us(demax)-endUs));
+    check("pixeldata after HSYNC (min)", us(bpmin), us(1), lineUs, "us");
+    check("pixeldata before HSYNC (min)", us(fpmin), us(1), lineUs, "us");
+    check("pixeldata start (min)", us(dsmin), startUs-bpUs/2, centerUs, "us");
+    check("pixeldata start (max)", us(dsmax), startUs-bpUs/2, centerUs, "us");
+    check("pixeldata end (min)", us(demin), centerUs, endUs+fpUs/2, "us");
+    check("pixeldata end (max)", us(demax), centerUs, endUs+fpUs/2, "us");
+    check("pixeldata center (min)", us(cmin), centerUs-pixelUs, 
+      centerUs+pixelUs, "us");
+    check("pixeldata center (max)", us(cmax), centerUs-pixelUs, 
+      centerUs+pixelUs, "us");
+    check("pixeldata start jitter", us(dsmax-dsmin), 0, pixelUs, "us");
+  }
+  if (seammax>=seammin) {
+    // gap between the chunks of a wide line, in HSPI pixels
+    double spipixel=ESPVGAXHost::spiClockCycles();
+    printf("seam between chunks: %.0f..%.0f cycles, %.1f..%.1f pixels\n",
+      seammin, seammax, seammin/spipixel, seammax/spipixel);
+    check("seam gap (min)", us(seammin), 0, lineUs, "us");
+    check("seam jitter", us(seammax-seammin), 0, pixelUs, "us");
+  }
+  if (vstarts.size()<2) {
+    check("VSYNC pulses", vstarts.size(), 2, 1e9, "");
+  } else {
+    check("VSYNC pulse (min)", vwidthmin, vsyncLines, vsyncLines, "lines");
+    check("VSYNC pulse (max)", vwidthmax, vsyncLines, vsyncLines, "lines");
+    check("lines per frame (min)", fmin, t->vTotal, t->vTotal, "lines");
+    check("lines per frame (max)", fmax, t->vTotal, t->vTotal, "lines");
+    check("frame rate", 1e6/us(frametime), frameHz*(1-tol), frameHz*(1+tol),
+      "Hz");
+  }
+#ifdef ESPVGAX_SPI_PIPELINE
+  /*
+   * lines copied by the HSPI transfer done interrupt, with a front porch long
+   * enough for it. The first line of each frame is copied by vga_handler, 
+   * there is no transfer before it, and the black line at the beginning of
+   * the vertical blank is written by HSPI_VGA_fill
+   */
+  uint64_t datalines=n-nodata;
+  printf("lines copied by the SPI interrupt: %u of %llu\n", 
+    ESPVGAXHost::spistaged, (unsigned long long)datalines);
+  if (t->hTotal>=ESPVGAX::TIMING_640x480_55.hTotal)
+    check("lines copied by the SPI interrupt", ESPVGAXHost::spistaged, 
+      datalines-2*(frames+1), datalines, "lines");
+#endif
+  check("ISR late entries", lates, 0, 0, "");
+  check("HSPI transfers started while busy", ESPVGAXHost::spioverlaps, 0, 0, 
+    "");
+  check("ISR time (max)", us(busymax), 0, us(pmin), "us");
+  printf("\n%-36s %10s %22s\n", "check", "value", "accepted");
+  int fails=0;
+  for (size_t i=0; i!=checks.size(); i++) {
+    Check &c=checks[i];
+    bool ok=c.value>=c.min && c.value<=c.max;
+    fails+=ok ? 0 : 1;
+    printf("%-36s %10.3f %10.3f..%-10.3f %-5s %s\n", c.name, c.value, c.min,
+      c.max, c.unit, ok ? "PASS" : "FAIL");
+  }
+  printf("\nISR cycles per line: avg %.0f, max %llu (%.1f%% of the line)\n",
+    (double)busy/n, (unsigned long long)busymax, 100.0*busy/psum);
+#ifdef ESPVGAX_SPI_PIPELINE
+  printf("SPI interrupts: %u in %d lines, avg %.0f cycles\n", spicount, n,
+    spicount ? (double)spibusy/spicount : 0);
+#endif
+  printf("cycles left to the main loop: %.0f per line, %.0f per frame\n",
+    (double)free/n, (double)free/n*t->vTotal);
+  printf("ESPVGAX::frameISRCycles: %u of %u, frameFreeCycles: %u, "
+    "frameSavedCycles: %u\n",
+    ESPVGAX::frameISRCycles(), ESPVGAX::frameCycles(),
+    ESPVGAX::frameFreeCycles(), ESPVGAX::frameSavedCycles());
+#ifdef ESPVGAX_STATS
+  ESPVGAX::Stats st;
+  ESPVGAX::getStats(st);
+  printf("\nESPVGAX::getStats: %u lines, %u frames, %u cycles per line\n",
+    st.lines, st.frames, st.lineCycles);
+  printf("vga_handler cycles: min %u, avg %.0f, max %u\n", st.minCycles,
+    st.lines ? (double)st.sumCycles/st.lines : 0, st.maxCycles);
+  printf("busy waits: avg %.0f cycles per line, %.1f%% of vga_handler\n",
+    st.lines ? (double)st.waitCycles/st.lines : 0, 
+    st.sumCycles ? 100.0*st.waitCycles/st.sumCycles : 0);
+  printf("late lines: %u (max %u cycles), frames with overruns: %u\n",
+    st.lateLines, st.maxLate, st.overrunFrames);
+  for (int i=0; i!=ESPVGAX_STATS_BINS; i++)
+    if (st.histogram[i])
+      printf("  %5u..%-5u cycles: %u\n", i*st.lineCycles/ESPVGAX_STATS_BINS,
+        (i+1)*st.lineCycles/ESPVGAX_STATS_BINS-1, st.histogram[i]);
+#endif
+  printf("\n%d checks failed\n", fails);
+  return fails ? 1 : 0;
+}